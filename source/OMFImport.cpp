@@ -21,6 +21,9 @@
 #include "OMFImport.h"
 #include "OMFEndian.h"
 
+// Binary data larger than this is mapped from the file instead of read into memory
+static const qint64 inMemoryBytes = Q_INT64_C(1) << 30;
+
 QSharedPointer<OMFReader> readOMF(QString &path)
 {
     bool success;
@@ -178,6 +181,11 @@ bool OMFReader::parseSegment()
         return false;
     }
 
+    // Vacuum of patterned geometries is not stored
+    if (valuedim != 1) {
+        field->compact();
+    }
+
     return true;
 }
 
@@ -330,9 +338,7 @@ bool OMFReader::parseDataBinary4()
         return false;
     }
 
-    // Create field matrix object
-    field = QSharedPointer<matrix>(new matrix(xnodes, ynodes, znodes));
-    const int num_cells = field->num_elements();
+    const qint64 num_cells = (qint64)xnodes*ynodes*znodes;
 
     // Read magic value and field contents from file
     double magic;
@@ -352,6 +358,13 @@ bool OMFReader::parseDataBinary4()
 
     if (magic != 1234567.0) qDebug() << "Wrong magic number (binary 4 format)";
 
+    if (mapData(sizeof(float))) {
+        return field->isMapped();
+    }
+
+    // Create field matrix object
+    field = QSharedPointer<matrix>(new matrix(xnodes, ynodes, znodes));
+
     QByteArray dataArray;
     if (valuedim == 1) {
         dataArray = file.read(num_cells*sizeof(float));
@@ -368,7 +381,7 @@ bool OMFReader::parseDataBinary4()
 
     QVector3D val;
     double v1, v2, v3;
-    for (int i=0; i<num_cells; ++i) {
+    for (qint64 i=0; i<num_cells; ++i) {
         if (valuedim == 1) {
             dataStream >> v1;
             if (version==1) {
@@ -401,9 +414,7 @@ bool OMFReader::parseDataBinary8()
         return false;
     }
 
-    // Create field matrix object
-    field = QSharedPointer<matrix>(new matrix(xnodes, ynodes, znodes));
-    const int num_cells = field->num_elements();
+    const qint64 num_cells = (qint64)xnodes*ynodes*znodes;
 
     // Read magic value and field contents from file
     double magic;
@@ -420,6 +431,13 @@ bool OMFReader::parseDataBinary8()
 
     if (magic != 123456789012345.0) qDebug() << "Wrong magic number (binary 8 format)";
 
+    if (mapData(sizeof(double))) {
+        return field->isMapped();
+    }
+
+    // Create field matrix object
+    field = QSharedPointer<matrix>(new matrix(xnodes, ynodes, znodes));
+
     QByteArray dataArray;
     if (valuedim == 1) {
         dataArray = file.read(num_cells*sizeof(double));
@@ -436,7 +454,7 @@ bool OMFReader::parseDataBinary8()
 
     QVector3D val;
     double v1, v2, v3;
-    for (int i=0; i<num_cells; ++i) {
+    for (qint64 i=0; i<num_cells; ++i) {
         if (valuedim == 1) {
             dataStream >> v1;
             if (version==1) {
@@ -455,3 +473,21 @@ bool OMFReader::parseDataBinary8()
     return true;
 }
 
+bool OMFReader::mapData(int valueBytes)
+{
+    // Large files are read on demand, straight from the page cache
+    int components = (valuedim == 1) ? 1 : 3;
+    qint64 bytes = (qint64)xnodes*ynodes*znodes*components*valueBytes;
+    if (bytes <= inMemoryBytes) {
+        return false;
+    }
+
+    matrixMapping layout;
+    layout.offset     = file.pos();
+    layout.valuedim   = components;
+    layout.valueBytes = valueBytes;
+    layout.bigEndian  = (version == 1);
+    layout.multiplier = (version == 1) ? valuemultiplier : 1.0;
+    field = QSharedPointer<matrix>(new matrix(xnodes, ynodes, znodes, file.fileName(), layout));
+    return true;
+}
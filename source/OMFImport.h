@@ -59,6 +59,7 @@ private:
     bool parseDataAscii();
     bool parseDataBinary4();
     bool parseDataBinary8();
+    bool mapData(int valueBytes);
     void acceptLine();
 
     // OMFHeader header;
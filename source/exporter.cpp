@@ -0,0 +1,125 @@
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+
+#include "exporter.h"
+#include "glcontext.h"
+#include "OMFImport.h"
+
+Exporter::Exporter(QStringList inputs, QString dir, QSize size)
+    : exportDir(dir), exportSize(size), context(0), surface(0), renderer(0), prefs(0)
+{
+    // Directories contribute their data files, in name order
+    foreach (QString item, inputs) {
+        QFileInfo info(item);
+        if (!info.exists()) {
+            qWarning() << "File" << item << "does not exist";
+        } else if (info.isDir()) {
+            QDir chosenDir(item);
+            QStringList filters;
+            filters << "*.omf" << "*.ovf";
+            chosenDir.setNameFilters(filters);
+            foreach (QString file, chosenDir.entryList()) {
+                filenames << chosenDir.filePath(file);
+            }
+        } else {
+            filenames << item;
+        }
+    }
+}
+
+Exporter::~Exporter()
+{
+    // GL objects go with the renderer, while the context is current
+    if (renderer) {
+        context->makeCurrent(surface);
+        delete renderer;
+        context->doneCurrent();
+    }
+    delete context;
+    delete surface;
+    delete prefs;
+}
+
+bool Exporter::initialize()
+{
+    QSurfaceFormat format;
+#ifdef __APPLE__
+    format.setVersion(3, 2);
+#else
+    format.setVersion(3, 3);
+#endif
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setRenderableType(QSurfaceFormat::OpenGL);
+    context = createGLContext(format);
+    if (!context) {
+        qWarning() << "Could not create an OpenGL" << format.majorVersion() << "." << format.minorVersion() << "context";
+        return false;
+    }
+    surface = new QOffscreenSurface();
+    surface->setFormat(context->format());
+    surface->create();
+
+    renderer = new GLRenderer();
+    renderer->setContext(context);
+    renderer->setSurface(surface);
+    if (!renderer->isInitialized()) {
+        qWarning() << "Could not make the OpenGL context current offscreen";
+        return false;
+    }
+    applyPreferences();
+    return true;
+}
+
+void Exporter::applyPreferences()
+{
+    // The defaults the window starts with, and its initial view
+    prefs = new Preferences();
+    renderer->setBackgroundColor(prefs->getBackgroundColor());
+    renderer->setSpriteDimensions(prefs->getSpriteResolution(), prefs->getVectorLength(), prefs->getVectorRadius(),
+                                  prefs->getVectorTipToTail(), prefs->getVectorInnerToOuter(), prefs->getVectorOrigin());
+    renderer->setBrightness(prefs->getBrightness());
+    renderer->setColoredQuantity(prefs->getColorQuantity());
+    renderer->setColorScale(prefs->getColorScale());
+    renderer->setSpriteScale(prefs->getSpriteScale());
+    renderer->setCustomColorScale(prefs->getCustomColorScale());
+    renderer->setUploadTolerance(prefs->getUploadTolerance());
+    renderer->setTargetFrameRate(prefs->getTargetFrameRate());
+    renderer->setRenderScaleRange(prefs->getMinRenderScale(), prefs->getMaxRenderScale());
+    renderer->setXRotation(345 * 1600);
+}
+
+bool Exporter::exportImages()
+{
+    QDir dir(exportDir);
+    if (!dir.exists() && !dir.mkpath(".")) {
+        qWarning() << "Could not create" << exportDir;
+        return false;
+    }
+    if (filenames.isEmpty()) {
+        qWarning() << "No omf or ovf files to export";
+        return false;
+    }
+    if (!initialize()) {
+        return false;
+    }
+    QString format = (prefs->getFormat()).toLower();
+    bool result = true;
+    for (int i=0; i<filenames.length(); i++) {
+        QSharedPointer<OMFReader> omf = readOMF(filenames[i]);
+        if (omf.isNull()) {
+            qWarning() << "Error loading file" << filenames[i] << ", skipping...";
+            result = false;
+            continue;
+        }
+        renderer->updateData(omf);
+        QString outpath = dir.filePath(QFileInfo(filenames[i]).completeBaseName()+"."+format);
+        QImage image = renderer->renderImage(exportSize);
+        if (image.isNull() || !image.save(outpath, 0, 90)) {
+            qWarning() << "Could not save" << outpath;
+            result = false;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,35 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSize>
+#include <QStringList>
+
+#include "glrenderer.h"
+#include "preferences.h"
+
+// Renders input files to images from the command line, on a context and
+// offscreen surface of its own. No window is made, so it runs without a
+// display, e.g. on Mesa's llvmpipe through EGL, see createGLContext.
+class Exporter
+{
+public:
+    Exporter(QStringList inputs, QString dir, QSize size);
+    ~Exporter();
+    bool exportImages(); // Every input file, returns false if any failed
+
+private:
+    bool initialize();
+    void applyPreferences();
+
+    QStringList filenames;
+    QString exportDir;
+    QSize exportSize;
+    QOpenGLContext *context;
+    QOffscreenSurface *surface;
+    GLRenderer *renderer;
+    Preferences *prefs; // Only for the defaults of the dialog
+};
+
+#endif // EXPORTER_H
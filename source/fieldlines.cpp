@@ -0,0 +1,126 @@
+#include <QtConcurrent>
+#include <math.h>
+#include "fieldlines.h"
+
+fieldLineTracer::fieldLineTracer(QSharedPointer<matrix> field, QVector3D low, QVector3D high)
+    : field(field), low(low), high(high)
+{
+    size = field->shape();
+    stepSize = 0.5f;
+    maxSteps = 4096;
+}
+
+QVector<fieldLine> fieldLineTracer::trace(const QVector<QVector3D> &seeds)
+{
+    // Each seed is independent
+    return QtConcurrent::blockingMapped<QVector<fieldLine> >(seeds, *this);
+}
+
+QVector<QVector3D> fieldLineTracer::gridSeeds(int spacing)
+{
+    QVector<QVector3D> seeds;
+    for (float z = ceilf(low.z()); z <= high.z() && z < size[2]; z += spacing) {
+        for (float y = ceilf(low.y()); y <= high.y() && y < size[1]; y += spacing) {
+            for (float x = ceilf(low.x()); x <= high.x() && x < size[0]; x += spacing) {
+                seeds << QVector3D(x, y, z);
+            }
+        }
+    }
+    return seeds;
+}
+
+QVector<QVector3D> fieldLineTracer::planeSeeds(int spacing)
+{
+    QVector<QVector3D> seeds;
+    float z = qBound(0.0f, ceilf(low.z()), (float)(size[2]-1));
+    for (float y = ceilf(low.y()); y <= high.y() && y < size[1]; y += spacing) {
+        for (float x = ceilf(low.x()); x <= high.x() && x < size[0]; x += spacing) {
+            seeds << QVector3D(x, y, z);
+        }
+    }
+    return seeds;
+}
+
+fieldLine fieldLineTracer::operator()(const QVector3D &seed)
+{
+    // Backwards from the seed, reversed, then forwards
+    fieldLine line;
+    QVector<QVector3D> points, values;
+    integrate(seed, -stepSize, points, values);
+    for (int i=points.size()-1; i>0; i--) {
+        line.points << points[i];
+        line.values << values[i];
+    }
+    integrate(seed, stepSize, line.points, line.values);
+    return line;
+}
+
+QVector3D fieldLineTracer::sample(const QVector3D &p)
+{
+    // Trilinear interpolation between cell centres
+    int i0[3], i1[3];
+    float f[3];
+    for (int axis=0; axis<3; axis++) {
+        float c = qBound(0.0f, p[axis], (float)(size[axis]-1));
+        i0[axis] = (int)c;
+        i1[axis] = qMin(i0[axis]+1, size[axis]-1);
+        f[axis]  = c - i0[axis];
+    }
+
+    QVector3D c00 = field->at(i0[0],i0[1],i0[2])*(1.0f-f[0]) + field->at(i1[0],i0[1],i0[2])*f[0];
+    QVector3D c10 = field->at(i0[0],i1[1],i0[2])*(1.0f-f[0]) + field->at(i1[0],i1[1],i0[2])*f[0];
+    QVector3D c01 = field->at(i0[0],i0[1],i1[2])*(1.0f-f[0]) + field->at(i1[0],i0[1],i1[2])*f[0];
+    QVector3D c11 = field->at(i0[0],i1[1],i1[2])*(1.0f-f[0]) + field->at(i1[0],i1[1],i1[2])*f[0];
+    QVector3D c0  = c00*(1.0f-f[1]) + c10*f[1];
+    QVector3D c1  = c01*(1.0f-f[1]) + c11*f[1];
+    return c0*(1.0f-f[2]) + c1*f[2];
+}
+
+QVector3D fieldLineTracer::direction(const QVector3D &p)
+{
+    // Unit tangent, or zero where the field vanishes
+    QVector3D v = sample(p);
+    float length = v.length();
+    if (!(length > 1e-12f)) {
+        return QVector3D();
+    }
+    return v/length;
+}
+
+bool fieldLineTracer::inside(const QVector3D &p)
+{
+    for (int axis=0; axis<3; axis++) {
+        if (!(p[axis] >= qMax(low[axis], 0.0f)) || p[axis] > qMin(high[axis], (float)(size[axis]-1))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void fieldLineTracer::integrate(QVector3D p, float h, QVector<QVector3D> &points, QVector<QVector3D> &values)
+{
+    if (!inside(p)) {
+        return;
+    }
+    points << p;
+    values << sample(p);
+
+    for (int step=0; step<maxSteps; step++) {
+        QVector3D k1 = direction(p);
+        QVector3D k2 = direction(p + 0.5f*h*k1);
+        QVector3D k3 = direction(p + 0.5f*h*k2);
+        QVector3D k4 = direction(p + h*k3);
+        QVector3D delta = (h/6.0f)*(k1 + 2.0f*k2 + 2.0f*k3 + k4);
+
+        // Stagnation points and the box boundary end the line
+        if (delta.lengthSquared() < 1e-8f*h*h) {
+            break;
+        }
+        p += delta;
+        if (!inside(p)) {
+            break;
+        }
+        points << p;
+        values << sample(p);
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef FIELDLINES_H
+#define FIELDLINES_H
+#include <QVector>
+#include <QVector3D>
+#include <QSharedPointer>
+#include "matrix.h"
+
+// Points along one streamline, in grid coordinates, and the
+// interpolated field at each of them
+struct fieldLine
+{
+    QVector<QVector3D> points;
+    QVector<QVector3D> values;
+};
+
+// Traces streamlines of a vector field with fixed step RK4 and trilinear
+// interpolation, staying inside the box [low, high] of grid coordinates
+class fieldLineTracer
+{
+public:
+    fieldLineTracer(QSharedPointer<matrix> field, QVector3D low, QVector3D high);
+    QVector<fieldLine> trace(const QVector<QVector3D> &seeds);
+
+    // Seeds every spacing cells inside the box, or on its low z face
+    QVector<QVector3D> gridSeeds(int spacing);
+    QVector<QVector3D> planeSeeds(int spacing);
+
+    typedef fieldLine result_type;
+    fieldLine operator()(const QVector3D &seed);
+
+    float stepSize; // In cells
+    int maxSteps;   // In each direction from the seed
+
+private:
+    QVector3D sample(const QVector3D &p);
+    QVector3D direction(const QVector3D &p);
+    bool inside(const QVector3D &p);
+    void integrate(QVector3D p, float h, QVector<QVector3D> &points, QVector<QVector3D> &values);
+
+    QSharedPointer<matrix> field;
+    QVector<int> size;
+    QVector3D low, high;
+};
+
+#endif // FIELDLINES_H
@@ -0,0 +1,90 @@
+#include <QDebug>
+#include <QGuiApplication>
+#include <QVariant>
+#include "glcontext.h"
+
+#if defined(Q_OS_LINUX) && QT_CONFIG(egl)
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <QtPlatformHeaders/QEGLNativeContext>
+
+static QOpenGLContext *adoptEGLContext(const QSurfaceFormat &format, QOpenGLContext *share)
+{
+    // The display eglfs renders to, and a config offscreen surfaces
+    // can be made with, since surfaceless Mesa has no window configs
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLContext shareContext = EGL_NO_CONTEXT;
+    if (share) {
+        QEGLNativeContext native = share->nativeHandle().value<QEGLNativeContext>();
+        display      = native.display();
+        shareContext = native.context();
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, 0, 0) || !eglBindAPI(EGL_OPENGL_API)) {
+        return 0;
+    }
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24, EGL_STENCIL_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs) || numConfigs < 1) {
+        qWarning() << "No EGL config for desktop OpenGL";
+        return 0;
+    }
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, format.majorVersion(),
+        EGL_CONTEXT_MINOR_VERSION, format.minorVersion(),
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, format.profile() == QSurfaceFormat::CoreProfile
+                                         ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT
+                                         : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext eglContext = eglCreateContext(display, config, shareContext, contextAttributes);
+    if (eglContext == EGL_NO_CONTEXT) {
+        qWarning() << "Could not create an EGL context, error" << QString("0x%1").arg(eglGetError(), 0, 16);
+        return 0;
+    }
+
+    // Adopted contexts are not destroyed with the QOpenGLContext
+    QOpenGLContext *context = new QOpenGLContext();
+    context->setFormat(format);
+    context->setShareContext(share);
+    context->setNativeHandle(QVariant::fromValue(QEGLNativeContext(eglContext, display)));
+    if (!context->create() || (share && !context->shareContext())) {
+        delete context;
+        eglDestroyContext(display, eglContext);
+        return 0;
+    }
+    return context;
+}
+#endif
+
+static bool formatMet(const QSurfaceFormat &format, QOpenGLContext *context)
+{
+    if (context->isOpenGLES() && format.renderableType() != QSurfaceFormat::OpenGLES) {
+        return false;
+    }
+    return context->format().version() >= format.version();
+}
+
+QOpenGLContext *createGLContext(const QSurfaceFormat &format, QOpenGLContext *share)
+{
+    QOpenGLContext *context = new QOpenGLContext();
+    context->setFormat(format);
+    context->setShareContext(share);
+    if (context->create() && (!share || context->shareContext()) && formatMet(format, context)) {
+        return context;
+    }
+    delete context;
+#if defined(Q_OS_LINUX) && QT_CONFIG(egl)
+    if (QGuiApplication::platformName() == "eglfs") {
+        return adoptEGLContext(format, share);
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef GLCONTEXT_H
+#define GLCONTEXT_H
+
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+
+// Creates a context of the given format, in the share group of share if
+// one is given, or returns 0. Without a display, eglfs on Mesa's
+// surfaceless platform only finds OpenGL ES configs, so there a desktop
+// context is made through EGL directly and adopted.
+QOpenGLContext *createGLContext(const QSurfaceFormat &format, QOpenGLContext *share = 0);
+
+#endif // GLCONTEXT_H
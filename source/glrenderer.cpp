@@ -0,0 +1,2098 @@
+#include <QCoreApplication>
+#include <QOpenGLExtraFunctions>
+#include <QScreen>
+#include <QThread>
+#include <QTimer>
+#include <QWindow>
+#include <QtConcurrent>
+#include <QtMath>
+#include <climits>
+#include <math.h>
+#include "glrenderer.h"
+
+// Most glyph instances pushed for data mapped from disk
+static const qint64 streamedInstances = 1 << 24;
+
+// Largest grid coordinate of glyph and face positions, packed as unsigned shorts
+static const int maxPackedCoordinate = 65535;
+
+// Lattices with more cells are shown coarse first, then refined
+static const qint64 refineInstances = 1 << 20;
+
+// Minimum on-screen spacing (in pixels) of glyphs overlaid on thin films
+static const float filmGlyphSpacing = 24.0f;
+
+// Field lines traced from roughly this many seeds
+static const int fieldLineSeedCount = 512;
+
+// Traced field lines kept for recently shown frames
+static const int fieldLineCacheSize = 8;
+
+// Isosurfaces kept for recently shown frames and iso-values
+static const int isoCacheSize = 16;
+
+// Opacity per cell of the volume rendering
+static const float volumeDensity = 0.1f;
+
+// Exposed cube face meshes kept for recently shown frames
+static const int surfaceCacheSize = 8;
+
+// Longest an exported frame waits for the builder thread, in milliseconds
+static const int builderTimeout = 30000;
+
+// Projected glyph sizes (in pixels) below which the next coarser LOD is used
+static const float lodPixelSize[] = { 32.0f, 12.0f };
+
+static qint64 latticeCells(const QVector<int> &size, int level)
+{
+    qint64 cells = 1;
+    for (int axis=0; axis<3; axis++) {
+        int step = qMin(1 << level, size[axis]);
+        cells *= (size[axis] + step - 1)/step;
+    }
+    return cells;
+}
+
+// QOpenGLBuffer sizes and draw counts are ints, so larger meshes are refused
+static bool bufferFits(qint64 elements, qint64 elementSize)
+{
+    return elements*elementSize <= INT_MAX;
+}
+
+GLRenderer::GLRenderer( QObject* parent )
+    : QObject( parent )
+{
+    // Frames are drawn on request only, see requestRender
+    renderTimer = new QTimer(this);
+    renderTimer->setSingleShot(true);
+    renderTimer->setTimerType(Qt::PreciseTimer);
+    connect(renderTimer, SIGNAL(timeout()), this, SLOT(update()));
+
+    startupTimer.start();
+
+    // Defaults
+    glContext = 0;
+    surface = 0;
+    initialized = false;
+    refreshRate = 60.0;
+    backgroundColor = QColor::fromRgbF(0.9, 0.8, 1.0).dark();
+    displayOn  = false;
+    toggleDisplay(0); // Start with cubes
+    brightness = 1.0;
+    xRot = yRot = zRot = 0;
+    xLoc = yLoc = 0;
+    zoom = -300.0;
+    slices = 16;
+    // Glyph meshes are built on first use, see buildGlyph
+    cube.stale = film.stale = false;
+    cone.stale = vect.stale = impostor.stale = lines.stale = points.stale = true;
+    subsampling = 0;
+    pushedSubsampling = 0;
+    instanceScale = 1.0f;
+    numNodes = 0;
+    uploadTolerance = 0.0f;
+    shownBuffers = -1;
+    targetFrameRate = 30;
+    qualityDrop = qualityWait = 0;
+    renderScale = 1.0f;
+    minRenderScale = 0.5f;
+    maxRenderScale = 1.0f;
+    viewportWidth = viewportHeight = 1;
+    sceneFbo = 0;
+    upscaleVao = 0;
+    progressive = true;
+    refining = false;
+    refineLevel = 0;
+    pushedGeneration = 0;
+    finalShown = false;
+    finalLevel = 0;
+    builder = new instanceBuilder(this);
+    connect(builder, SIGNAL(frameReady()), this, SLOT(instancesReady()));
+    interacting = false;
+    settleTimer = 0;
+    cpuFrameTime = gpuFrameTime = 0.0f;
+    needsUpdate = needsPush = false;
+    filmMode = true;
+    filmDirty = false;
+    filmStep = 1;
+    surfaceMode = true;
+    surfaceDirty = false;
+    surfaceIndices = 0;
+    surfaceVao = 0;
+    greedyMode = true;
+    volumeMode = false;
+    volumeDirty = false;
+    volumeTexture = 0;
+    volumeStep = 1;
+    fieldLineSeeds = "Off";
+    fieldLinesDirty = false;
+    fieldLineVao = 0;
+    isoComponent = "Off";
+    isoValue = 800;
+    isoDirty = false;
+    isoSamples.component = -1;
+    for (int kind=0; kind<assetKinds; kind++) {
+        pushedAssets[kind] = shownAssets[kind] = 0;
+    }
+    isoVao = 0;
+    isoIndices = 0;
+    vectorLength = 1.0f;
+    vectorRadius = 0.5f;
+    vectorTipLengthRatio = 0.4f;
+    vectorShaftRadiusRatio = 0.4f;
+
+    // Slicing and Thresholding
+    xSliceLow=ySliceLow=zSliceLow=thresholdLow=0;
+    xSliceHigh=ySliceHigh=zSliceHigh=thresholdHigh=16*100;
+
+    // Map from display type to int
+
+    display_type_map["Full Orientation"] = 1;
+    display_type_map["In-Plane Angle"]   = 2;
+    display_type_map["X Coordinate"]      = 3;
+    display_type_map["Y Coordinate"]      = 4;
+    display_type_map["Z Coordinate"]      = 5;
+}
+
+GLRenderer::~GLRenderer()
+{
+    // Stopped before the caches its jobs work on go away
+    delete builder;
+}
+
+void GLRenderer::setContext(QOpenGLContext *context)
+{
+    // Instances are uploaded on the builder thread, through a context of its own
+    glContext = context;
+    builder->shareContext(glContext);
+}
+
+bool GLRenderer::isInitialized()
+{
+    return initialized;
+}
+
+void GLRenderer::moveToMainThread()
+{
+    // Only the thread an object lives in may push it elsewhere
+    QThread *mainThread = QCoreApplication::instance()->thread();
+    if (glContext) {
+        if (QOpenGLContext::currentContext() == glContext) {
+            glContext->doneCurrent();
+        }
+        glContext->moveToThread(mainThread);
+    }
+    moveToThread(mainThread);
+}
+
+void GLRenderer::setSurface(QSurface *target)
+{
+    surface = target;
+    if (surface && surface->surfaceClass() == QSurface::Window) {
+        QScreen *screen = static_cast<QWindow *>(surface)->screen();
+        if (screen && screen->refreshRate() > 1.0) {
+            refreshRate = screen->refreshRate();
+        }
+    }
+    // Shaders, buffers and sprites are made once, whatever the surface
+    if (!initialized && makeContextCurrent()) {
+        initialize();
+    }
+    requestRender();
+}
+
+bool GLRenderer::makeContextCurrent()
+{
+    if (!glContext || !surface) {
+        return false;
+    }
+    if (QOpenGLContext::currentContext() == glContext && glContext->surface() == surface) {
+        return true;
+    }
+    if (!glContext->makeCurrent(surface)) {
+        qWarning() << "Could not make the OpenGL context current";
+        return false;
+    }
+    return true;
+}
+
+QColor GLRenderer::customSpriteColor(float value) {
+    // Number of colors in the list
+    int numColors = customColors.length();
+
+    // Part of the mapping that value takes given this number of colors
+    float interval = 1.0f / (static_cast<float>(numColors) - 1.0f);
+
+    // Find which colors in the list we're in between
+    int firstColorIndex = static_cast<int>(0.999f*value/interval);
+    if (firstColorIndex > (numColors-2)) {
+        firstColorIndex = numColors-2;
+    }
+    QColor firstColor = customColors.at(firstColorIndex);
+    QColor secondColor = customColors.at(firstColorIndex + 1);
+
+    // Rescale the value to within 0:1
+    value = (value - firstColorIndex*interval)/interval;
+
+    // Linear interpolation between the chosen colors
+    qreal r = firstColor.redF() + value * (secondColor.redF() - firstColor.redF());
+    qreal g = firstColor.greenF() + value * (secondColor.greenF() - firstColor.greenF());
+    qreal b = firstColor.blueF() + value * (secondColor.blueF() - firstColor.blueF());
+
+    return QColor::fromRgbF(r,g,b);
+    
+}
+
+void GLRenderer::setCustomColorScale(QList<QColor> colors)
+{
+    // Set the private color variables to the inputs
+    customColors = colors;
+}
+
+void GLRenderer::setUploadTolerance(float percent)
+{
+    // Relative to the largest magnitude, like the snorm16 instance vectors
+    uploadTolerance = qBound(0.0f, percent/100.0f, 1.0f);
+}
+
+void GLRenderer::updateData(QSharedPointer<OMFReader> data)
+{
+    if (data.isNull()) {
+        displayOn = false;
+    } else {
+        valuedim = data->valuedim;
+        // Nothing set for the extents...
+        if (valuedim == 3) {
+            data->field->minmaxMagnitude(minmag, maxmag);
+        } else if (valuedim == 1) {
+            data->field->minmaxScalar(minmag, maxmag);
+        }
+        dataPtr    = data;
+        displayOn  = true;
+        // Update the display
+        updateCOM();
+        updateExtent();
+        needsPush   = true;
+        filmDirty   = true;
+        volumeDirty = true;
+        fieldLinesDirty = true;
+        isoDirty    = true;
+        requestRender();
+    }
+}
+
+void GLRenderer::pushLUT() {
+    if (colorScale !=  "HSL") {
+        QVector4D lut[256];
+        for (int i=0; i<256; i++) {
+            float h = ((float)i)/255.0;
+            if (colorScale ==  ("Grayscale")) {
+                spriteColor = QColor::fromHslF(0.0, 0.0, h);
+            } else if (colorScale ==  ("Blue to Red")) {
+                if (h <= 0.5) {
+                    spriteColor = QColor::fromHsvF(0.0,1.0-2.0*h,1.0);
+                } else {
+                    spriteColor = QColor::fromHsvF(0.5,(h-0.5)*2.0,1.0);
+                }
+            } else if (colorScale ==  ("Green to White")) {
+                spriteColor = QColor::fromHsvF(0.3,1.0-h,0.25+0.75*h);
+
+            } else if (colorScale ==  ("Custom")) {
+                spriteColor = customSpriteColor(h);
+            }
+
+            lut[i] = QVector4D(spriteColor.redF(), spriteColor.greenF(), spriteColor.blueF(), 0.0);
+        }
+        // Every program colours by the same table
+        QList<QOpenGLShaderProgram*> programs;
+        programs << &cubeShader << &standardShader << &impostorShader << &flatShader << &filmShader << &volumeShader << &fieldLineShader << &isoShader;
+        foreach (QOpenGLShaderProgram *program, programs) {
+            if (program->isLinked()) {
+                program->bind();
+                program->setUniformValueArray("color_lut", lut, 256);
+            }
+        }
+    }
+} 
+
+void GLRenderer::pushBuffers()
+{
+    // Buffers don't exist until the context has been initialized
+    if (displayOn && !pos_vbos.isEmpty()) {
+        QVector<int> size = dataPtr->field->shape();
+        // int numNodes = dataPtr->field->num_elements();
+
+        // Rather no glyphs than glyphs wrapped to the wrong place
+        if (!packedPositionsFit()) {
+            qWarning() << "Grid of" << size[0] << "x" << size[1] << "x" << size[2]
+                       << "cells is too large for glyphs, at most" << maxPackedCoordinate << "cells per axis";
+            pushedGeneration = 0; // Drops frames still being built
+            refining  = false;
+            finalShown = false;
+            numNodes  = 0;
+            instanceNodes.clear();
+            needsPush = false;
+            return;
+        }
+
+        // Thin films only need glyphs at a screen-density stride
+        int level = subsampling + extraSubsampling();
+        if (isFilm()) {
+            level = qMax(level, filmSubsampling());
+        }
+        // Data mapped from disk is pushed coarsely enough to fit the
+        // instance buffers, and only within the slice box
+        if (streamed()) {
+            while (level < 15 && latticeCells(size, level) > streamedInstances) {
+                level++;
+            }
+        }
+        sliceBox(pushedSliceLow, pushedSliceHigh);
+
+        // Large lattices are shown at a coarse level at once, and the
+        // requested level follows once the builder thread has it. Playback
+        // keeps the lattice already shown, so its frames skip the preview
+        // and stay partial uploads of the same instances.
+        bool sameLattice = finalShown && finalLevel == level && finalShape == size
+                           && finalSliceLow == pushedSliceLow && finalSliceHigh == pushedSliceHigh;
+        int coarse = level;
+        if (progressive && !sameLattice) {
+            while (coarse < 15 && latticeCells(size, coarse) > refineInstances) {
+                coarse++;
+            }
+        }
+
+        // Vectors are stored as snorm16, so normalize by the largest magnitude
+        instanceScale = qMax(qAbs(maxmag), qAbs(minmag));
+        if (instanceScale <= 0.0f) {
+            instanceScale = 1.0f;
+        }
+        instanceRequest req;
+        req.data      = dataPtr;
+        req.level     = level;
+        req.coarse    = coarse;
+        req.streamed  = streamed();
+        req.sliceLow  = pushedSliceLow;
+        req.sliceHigh = pushedSliceHigh;
+        req.scale     = instanceScale;
+        req.tolerance = uploadTolerance;
+        // A newer request abandons any still being built
+        pushedGeneration = builder->request(req);
+        refining    = true;
+        refineLevel = level;
+        needsPush = false;
+    }
+}
+
+void GLRenderer::instancesReady()
+{
+    requestRender();
+}
+
+void GLRenderer::adoptInstances(instanceFrame *frame)
+{
+    // Frames of superseded requests are dropped
+    makeContextCurrent();
+    if (frame->generation != pushedGeneration) {
+        builder->discard(frame);
+        return;
+    }
+    // Staged when the builder thread has no context to upload with
+    if (frame->buffers < 0 && !builder->upload(*frame)) {
+        builder->discard(frame);
+        return;
+    }
+    instanceNodes.swap(frame->nodes);
+    numNodes = instanceNodes.isEmpty() ? 0 : instanceNodes.first().count; // The root holds them all
+    pushedSubsampling = frame->level;
+    finalShown = frame->final;
+    if (frame->final) {
+        refining = false;
+        finalLevel = frame->level;
+        finalShape = dataPtr->field->shape();
+        finalSliceLow  = pushedSliceLow;
+        finalSliceHigh = pushedSliceHigh;
+        // Back off a level that collapsed the whole lattice into one cell.
+        // Cells left out as vacuum or by the slice box don't count, and
+        // level 0 is as fine as it gets.
+        if (subsampling > 0 && extraSubsampling() == 0
+            && latticeCells(finalShape, frame->level) <= 1) {
+            subsampling--;
+        }
+    }
+
+    // Draws from here on wait on the GPU for the upload. Shared by every
+    // sprite VAO, and pointed at by each draw, see setInstanceOffset.
+    if (frame->uploaded) {
+        gl330Funcs->glWaitSync(frame->uploaded, 0, GL_TIMEOUT_IGNORED);
+        gl330Funcs->glDeleteSync(frame->uploaded);
+    }
+    pos_vbos = frame->positionBuffers;
+    mag_vbos = frame->vectorBuffers;
+
+    // The set drawn so far is written again once the draws from it are done
+    if (shownBuffers >= 0) {
+        GLsync drawn = gl330Funcs->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        builder->release(shownBuffers, drawn);
+    }
+    shownBuffers = frame->buffers;
+    emit instancesUploaded(frame->uploadedPercent);
+    delete frame;
+
+    surfaceDirty = true;
+    needsUpdate = true;
+}
+
+bool GLRenderer::packedPositionsFit()
+{
+    // Face corners reach one past the last cell
+    QVector<int> size = dataPtr->field->shape();
+    return size[0] <= maxPackedCoordinate && size[1] <= maxPackedCoordinate && size[2] <= maxPackedCoordinate;
+}
+
+bool GLRenderer::streamed()
+{
+    // Frames too large to hold in memory, see OMFReader::mapData
+    return displayOn && dataPtr->field->isMapped();
+}
+
+bool GLRenderer::isFilm()
+{
+    // Single layer vector data, e.g. most Mumax3 runs
+    return filmMode && displayOn && valuedim == 3 && dataPtr->field->shape()[2] == 1;
+}
+
+int GLRenderer::filmSubsampling()
+{
+    // Keep overlaid glyphs at least filmGlyphSpacing pixels apart
+    float pixels = cellPixels();
+    int level = 0;
+    while (level < 15 && pixels*(1 << level) < filmGlyphSpacing) {
+        level++;
+    }
+    return level;
+}
+
+// Field packed like the instance data, every step-th cell where the
+// film is larger than the texture size limit
+class filmAssetJob : public assetJob
+{
+public:
+    filmAssetJob() : assetJob(filmKind), texture(0) {}
+    void extract();
+    void upload();
+    void destroy();
+
+    QSharedPointer<OMFReader> data;
+    float invScale;
+    GLint maxSize; // GL_MAX_TEXTURE_SIZE
+    int step, width, height;
+    std::vector<instanceVector> texels;
+    GLuint texture;
+};
+
+void filmAssetJob::extract()
+{
+    QVector<int> size = data->field->shape();
+    step = 1;
+    while ((size[0] + step - 1)/step > maxSize || (size[1] + step - 1)/step > maxSize) {
+        step *= 2;
+    }
+    if (step > 1) {
+        qWarning() << "Film of" << size[0] << "x" << size[1] << "cells exceeds the texture size limit, showing every" << step << "th cell";
+    }
+    width  = (size[0] + step - 1)/step;
+    height = (size[1] + step - 1)/step;
+
+    texels.resize((qint64)width*height);
+    for(int j=0; j<height; j++) {
+        for(int i=0; i<width; i++) {
+            QVector3D m = data->field->at(i*step,j*step,0) * invScale;
+            instanceVector v = { packSnorm16(m.x()), packSnorm16(m.y()), packSnorm16(m.z()) };
+            texels[(qint64)j*width + i] = v;
+        }
+    }
+}
+
+void filmAssetJob::upload()
+{
+    // Nearest filtering keeps individual cells crisp when zoomed in
+    QOpenGLExtraFunctions *gl = QOpenGLContext::currentContext()->extraFunctions();
+    gl->glGenTextures(1, &texture);
+    gl->glBindTexture(GL_TEXTURE_2D, texture);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 2); // Rows of 6 byte texels
+    gl->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16_SNORM, width, height, 0, GL_RGB, GL_SHORT, &texels.front());
+    gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    gl->glBindTexture(GL_TEXTURE_2D, 0);
+    std::vector<instanceVector>().swap(texels);
+}
+
+void filmAssetJob::destroy()
+{
+    QOpenGLContext::currentContext()->functions()->glDeleteTextures(1, &texture);
+}
+
+void GLRenderer::pushFilm()
+{
+    filmAssetJob *job = new filmAssetJob;
+    job->data     = dataPtr;
+    job->invScale = 1.0f/instanceScale;
+    job->maxSize  = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &job->maxSize);
+    submitAsset(job);
+    filmDirty = false;
+}
+
+void GLRenderer::drawFilm()
+{
+    QVector<int> size = dataPtr->field->shape();
+    setShaderUniforms(&filmShader);
+    filmShader.setUniformValue("film_size", QVector2D(size[0], size[1]));
+    filmShader.setUniformValue("film_step", (GLfloat)filmStep);
+    filmShader.setUniformValue("film",      0);
+
+    gl330Funcs->glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, filmTexture);
+
+    // Visible from both sides
+    glDisable( GL_CULL_FACE );
+    film.vao->bind();
+    gl330Funcs->glDrawElementsInstanced( film.mode, film.lods[0].count, GL_UNSIGNED_INT, 0, 1);
+    film.vao->release();
+    glEnable( GL_CULL_FACE );
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Shared state for extracting the exposed faces of the cube volume
+struct surfaceContext
+{
+    matrix *field;        // Pyramid level, or the grid itself
+    int incr[3];          // Grid cells per lattice cell, as in pushBuffers
+    int stride[3];        // Field cells per lattice cell
+    int n[3];             // Lattice size
+    QVector3D low, high;  // Slice box
+    float thrLo, thrHi, maxmag, invScale;
+    int displayType;      // Coloured quantity, as in cube.vert
+    bool useLUT;
+    bool greedy;          // Merge neighbouring faces of the same colour
+    std::vector<int> bins; // Colour bin of every lattice cell, -1 if hidden
+};
+
+// One unit of parallel work: an x-slab when classifying cells,
+// a plane of faces normal to an axis when extracting them
+struct surfaceJob
+{
+    surfaceContext *context;
+    int axis, plane;
+    std::vector<surfaceVertex> vertices;
+};
+
+static inline qint64 latticeIndex(const surfaceContext &c, const int cell[3])
+{
+    return ((qint64)cell[0]*c.n[1] + cell[1])*c.n[2] + cell[2];
+}
+
+static int colorBin(const surfaceContext &c, const QVector3D &m)
+{
+    // Hue and luminance as computed in cube.vert, quantized like the LUT
+    if (!c.greedy) {
+        return 0;
+    }
+    float mag = m.length();
+    if (!(mag > 0.0f)) {
+        return 1 << 16;
+    }
+    float comp[3] = { m.x(), m.y(), m.z() };
+    float hue = atan2(m.y(), m.x())/(2.0*M_PI);
+    float lum = 0.5f;
+    if (c.displayType == 1)
+        lum = 0.5f + 0.5f*m.z()/mag;
+    if (c.displayType >= 3)
+        hue = 0.5f + 0.5f*comp[c.displayType-3]/mag;
+
+    int bin = (int)(255.0f*hue) + 256;
+    if (!c.useLUT) {
+        bin += 512*(int)(255.0f*lum);
+    }
+    return bin;
+}
+
+static void classifyCells(surfaceJob &job)
+{
+    // Same tests as the vertex shaders apply to instanced cubes
+    surfaceContext &c = *job.context;
+    int cell[3] = { job.plane, 0, 0 };
+    int x = cell[0]*c.incr[0];
+    for (cell[1]=0; cell[1]<c.n[1]; cell[1]++) {
+        int y = cell[1]*c.incr[1];
+        for (cell[2]=0; cell[2]<c.n[2]; cell[2]++) {
+            int z = cell[2]*c.incr[2];
+            int sx = cell[0]*c.stride[0], sy = cell[1]*c.stride[1], sz = cell[2]*c.stride[2];
+            QVector3D m = c.field->at(sx, sy, sz);
+            float relmag = m.length()/c.maxmag;
+            bool shown = c.field->occupied(sx, sy, sz) &&
+                         !(relmag < c.thrLo - 0.01f) && !(relmag > c.thrHi + 0.01f) &&
+                         x >= c.low.x() && x <= c.high.x() &&
+                         y >= c.low.y() && y <= c.high.y() &&
+                         z >= c.low.z() && z <= c.high.z();
+            c.bins[latticeIndex(c, cell)] = shown ? colorBin(c, m) : -1;
+        }
+    }
+}
+
+static void extractExposedFaces(surfaceJob &job)
+{
+    const surfaceContext &c = *job.context;
+    int a  = job.axis;
+    int ua = (a + 1) % 3;
+    int va = (a + 2) % 3;
+    int nu = c.n[ua], nv = c.n[va];
+    std::vector<int> mask(nu*nv);
+
+    for (int sign=1; sign>=-1; sign-=2) {
+        // Faces of this plane not hidden by a visible neighbour
+        int cell[3];
+        cell[a] = job.plane;
+        for (int v=0; v<nv; v++) {
+            for (int u=0; u<nu; u++) {
+                cell[ua] = u;
+                cell[va] = v;
+                int bin = c.bins[latticeIndex(c, cell)];
+                cell[a] += sign;
+                if (bin >= 0 && cell[a] >= 0 && cell[a] < c.n[a] && c.bins[latticeIndex(c, cell)] >= 0) {
+                    bin = -1;
+                }
+                cell[a] -= sign;
+                mask[v*nu + u] = bin;
+            }
+        }
+
+        for (int v=0; v<nv; v++) {
+            for (int u=0; u<nu; u++) {
+                int bin = mask[v*nu + u];
+                if (bin < 0) {
+                    continue;
+                }
+
+                // Grow the quad along u, then along v, while the colour stays the same
+                int w = 1, h = 1;
+                if (c.greedy) {
+                    while (u + w < nu && mask[v*nu + u + w] == bin) {
+                        w++;
+                    }
+                    bool grow = true;
+                    while (grow && v + h < nv) {
+                        for (int k=0; k<w; k++) {
+                            if (mask[(v + h)*nu + u + k] != bin) {
+                                grow = false;
+                                break;
+                            }
+                        }
+                        if (grow) {
+                            h++;
+                        }
+                    }
+                }
+                for (int j=0; j<h; j++) {
+                    for (int k=0; k<w; k++) {
+                        mask[(v + j)*nu + u + k] = -1;
+                    }
+                }
+
+                // The quad takes its colour and position from its first cell
+                cell[ua] = u;
+                cell[va] = v;
+                int grid[3] = { cell[0]*c.incr[0], cell[1]*c.incr[1], cell[2]*c.incr[2] };
+                QVector3D m = c.field->at(cell[0]*c.stride[0], cell[1]*c.stride[1], cell[2]*c.stride[2]) * c.invScale;
+                surfaceVertex vertex;
+                vertex.magnetization.x = packSnorm16(m.x());
+                vertex.magnetization.y = packSnorm16(m.y());
+                vertex.magnetization.z = packSnorm16(m.z());
+                vertex.translation.x = (GLushort)grid[0];
+                vertex.translation.y = (GLushort)grid[1];
+                vertex.translation.z = (GLushort)grid[2];
+
+                // Cubes span [-1,1] before scaling, so one lattice step is 2 units
+                float n[3] = { 0.0f, 0.0f, 0.0f };
+                n[a] = sign;
+                vertex.nx = n[0];
+                vertex.ny = n[1];
+                vertex.nz = n[2];
+                float corners[4][2] = { {-1.0f, -1.0f}, {2.0f*w - 1.0f, -1.0f},
+                                        {2.0f*w - 1.0f, 2.0f*h - 1.0f}, {-1.0f, 2.0f*h - 1.0f} };
+                for (int k=0; k<4; k++) {
+                    // Counter-clockwise when seen from outside
+                    int corner = (sign > 0) ? k : (4 - k) % 4;
+                    float p[3];
+                    p[a]  = sign;
+                    p[ua] = corners[corner][0];
+                    p[va] = corners[corner][1];
+                    vertex.x = p[0];
+                    vertex.y = p[1];
+                    vertex.z = p[2];
+                    job.vertices.push_back(vertex);
+                }
+            }
+        }
+    }
+}
+
+// Exposed faces of the cube volume at the level of the instances
+class surfaceAssetJob : public assetJob
+{
+public:
+    surfaceAssetJob() : assetJob(surfaceKind), indexCount(0) {}
+    void extract();
+    void upload();
+    void destroy();
+
+    QSharedPointer<OMFReader> data;
+    surfaceContext context; // Its field and lattice are left to extract
+    int level;
+    QList<surfaceCacheEntry> *cache; // Only touched on the builder thread
+    std::vector<surfaceVertex> vertices;
+    std::vector<GLuint> indices;
+    int indexCount;
+    QOpenGLBuffer vbo, ibo;
+};
+
+void surfaceAssetJob::extract()
+{
+    // Off the rendering thread, so the pyramid level may be averaged here
+    QVector<int> size = data->field->shape();
+    context.field = data->field->level(level);
+    for (int axis=0; axis<3; axis++) {
+        context.incr[axis]   = qMin(1 << level, size[axis]);
+        context.stride[axis] = context.field ? 1 : context.incr[axis];
+        context.n[axis]      = (size[axis] + context.incr[axis] - 1)/context.incr[axis];
+    }
+    if (!context.field) {
+        context.field = data->field.data();
+    }
+
+    // Frames being played back keep their meshes
+    QVector<float> key;
+    key << level << context.low.x() << context.low.y() << context.low.z()
+        << context.high.x() << context.high.y() << context.high.z()
+        << context.thrLo << context.thrHi << context.greedy;
+    if (context.greedy) {
+        key << context.displayType << context.useLUT;
+    }
+
+    int cached = -1;
+    for (int i=0; i<cache->size(); i++) {
+        if ((*cache)[i].frame == data && (*cache)[i].key == key) {
+            cached = i;
+            break;
+        }
+    }
+
+    if (cached >= 0) {
+        cache->move(cached, 0);
+        vertices = cache->first().vertices;
+    } else {
+        context.bins.resize((size_t)context.n[0]*context.n[1]*context.n[2]);
+
+        QVector<surfaceJob> slabs(context.n[0]);
+        for (int i=0; i<slabs.size(); i++) {
+            slabs[i].context = &context;
+            slabs[i].axis    = 0;
+            slabs[i].plane   = i;
+        }
+        QtConcurrent::blockingMap(slabs, classifyCells);
+
+        QVector<surfaceJob> planes;
+        for (int axis=0; axis<3; axis++) {
+            for (int i=0; i<context.n[axis]; i++) {
+                surfaceJob job;
+                job.context = &context;
+                job.axis    = axis;
+                job.plane   = i;
+                planes << job;
+            }
+        }
+        QtConcurrent::blockingMap(planes, extractExposedFaces);
+        std::vector<int>().swap(context.bins);
+
+        size_t numVertices = 0;
+        for (int i=0; i<planes.size(); i++) {
+            numVertices += planes[i].vertices.size();
+        }
+        vertices.reserve(numVertices);
+        for (int i=0; i<planes.size(); i++) {
+            vertices.insert(vertices.end(), planes[i].vertices.begin(), planes[i].vertices.end());
+        }
+
+        surfaceCacheEntry entry;
+        entry.frame    = data;
+        entry.key      = key;
+        entry.vertices = vertices;
+        cache->prepend(entry);
+        while (cache->size() > surfaceCacheSize) {
+            cache->removeLast();
+        }
+    }
+
+    // Bounded by the lattice, as the instances of the level may not be shown yet
+    qint64 numFaces = vertices.size()/4;
+    if (numFaces == 0 || numFaces > (qint64)context.n[0]*context.n[1]*context.n[2]) {
+        // Noisy thresholds can expose more faces than there are cubes
+        std::vector<surfaceVertex>().swap(vertices);
+        return;
+    }
+    // The instanced cubes are drawn instead
+    if (!bufferFits(4*numFaces, sizeof(surfaceVertex)) || !bufferFits(6*numFaces, sizeof(GLuint))) {
+        qWarning() << "Surface of" << numFaces << "faces is too large for one buffer, drawing cubes instead";
+        std::vector<surfaceVertex>().swap(vertices);
+        return;
+    }
+
+    indices.reserve(6*numFaces);
+    for (qint64 face=0; face<numFaces; face++) {
+        GLuint first = 4*face;
+        indices.push_back(first);
+        indices.push_back(first+1);
+        indices.push_back(first+2);
+        indices.push_back(first);
+        indices.push_back(first+2);
+        indices.push_back(first+3);
+    }
+    indexCount = indices.size();
+}
+
+void surfaceAssetJob::upload()
+{
+    if (indices.empty()) {
+        return;
+    }
+    vbo = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    ibo = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+    vbo.create();
+    ibo.create();
+    vbo.bind();
+    vbo.allocate(&vertices[0], vertices.size()*sizeof(surfaceVertex));
+    vbo.release();
+    ibo.bind();
+    ibo.allocate(&indices[0], indices.size()*sizeof(GLuint));
+    ibo.release();
+    std::vector<surfaceVertex>().swap(vertices);
+    std::vector<GLuint>().swap(indices);
+}
+
+void surfaceAssetJob::destroy()
+{
+    vbo.destroy();
+    ibo.destroy();
+}
+
+bool GLRenderer::useSurface()
+{
+    return surfaceMode && displayOn && surfaceVao && dataPtr->field->shape()[2] > 1;
+}
+
+void GLRenderer::pushSurface()
+{
+    surfaceDirty = false;
+    if (!packedPositionsFit()) {
+        surfaceIndices = 0;
+        return;
+    }
+
+    surfaceAssetJob *job = new surfaceAssetJob;
+    surfaceContext &context = job->context;
+    job->data     = dataPtr;
+    job->level    = pushedSubsampling;
+    job->cache    = &surfaceCache;
+    sliceBox(context.low, context.high);
+    context.thrLo       = ((GLfloat)thresholdLow)/1600.0;
+    context.thrHi       = ((GLfloat)thresholdHigh)/1600.0;
+    context.maxmag      = maxmag;
+    context.invScale    = 1.0f/instanceScale;
+    context.displayType = display_type_map[coloredQuantity];
+    context.useLUT      = (colorScale != "HSL");
+    context.greedy      = greedyMode && valuedim == 1;
+    submitAsset(job);
+}
+
+void GLRenderer::drawSurface()
+{
+    setShaderUniforms(&cubeShader);
+    surfaceVao->bind();
+    glDrawElements(GL_TRIANGLES, surfaceIndices, GL_UNSIGNED_INT, 0);
+    surfaceVao->release();
+}
+
+void GLRenderer::setSurfaceMode(bool on)
+{
+    surfaceMode  = on;
+    surfaceDirty = true;
+    requestRender();
+}
+
+void GLRenderer::setGreedyMode(bool on)
+{
+    greedyMode   = on;
+    surfaceDirty = true;
+    requestRender();
+}
+
+bool GLRenderer::useVolume()
+{
+    // The whole volume would have to be read into a texture
+    return volumeMode && displayOn && valuedim == 1 && volumeTexture && !streamed();
+}
+
+// Staging for the volume texture is kept to this many texels at a time
+static const qint64 volumeSlabTexels = 1 << 23;
+
+// Scalars normalized to the full unorm16 range, x fastest. Volumes larger
+// than the 3D texture size limit are averaged over blocks of step cells.
+class volumeAssetJob : public assetJob
+{
+public:
+    volumeAssetJob() : assetJob(volumeKind), texture(0) {}
+    void extract();
+    void upload();
+    void destroy();
+
+    QSharedPointer<OMFReader> data;
+    float minmag, maxmag;
+    GLint maxSize; // GL_MAX_3D_TEXTURE_SIZE
+    matrix *source;
+    int step;
+    QVector<int> size; // Texels along x, y and z
+    GLuint texture;
+};
+
+void volumeAssetJob::extract()
+{
+    // The pyramid level is averaged here, so only the conversion is
+    // left to upload, one slab of texels at a time
+    QVector<int> cells = data->field->shape();
+    int level = 0;
+    step = 1;
+    while ((cells[0] + step - 1)/step > maxSize || (cells[1] + step - 1)/step > maxSize
+           || (cells[2] + step - 1)/step > maxSize) {
+        level++;
+        step *= 2;
+    }
+    if (step > 1) {
+        qWarning() << "Volume of" << cells[0] << "x" << cells[1] << "x" << cells[2]
+                   << "cells exceeds the 3D texture size limit, averaging blocks of" << step << "cells a side";
+    }
+    source = data->field->level(level);
+    size   = source->shape();
+}
+
+void volumeAssetJob::upload()
+{
+    // Interpolated between cell centres
+    QOpenGLExtraFunctions *gl = QOpenGLContext::currentContext()->extraFunctions();
+    gl->glGenTextures(1, &texture);
+    gl->glBindTexture(GL_TEXTURE_3D, texture);
+    gl->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gl->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    gl->glTexImage3D(GL_TEXTURE_3D, 0, GL_R16, size[0], size[1], size[2], 0,
+                     GL_RED, GL_UNSIGNED_SHORT, 0);
+
+    // A few layers at a time, rather than a second copy of the whole volume
+    float range = (maxmag > minmag) ? maxmag - minmag : 1.0f;
+    qint64 layerTexels = (qint64)size[0]*size[1];
+    int slab = (int)qBound((qint64)1, volumeSlabTexels/layerTexels, (qint64)size[2]);
+    std::vector<GLushort> texels(layerTexels*slab);
+    for (int first=0; first<size[2]; first+=slab) {
+        int layers = qMin(slab, size[2] - first);
+        size_t index = 0;
+        for(int k=first; k<first+layers; k++) {
+            for(int j=0; j<size[1]; j++) {
+                for(int i=0; i<size[0]; i++) {
+                    float value = (source->at(i,j,k).x() - minmag)/range;
+                    texels[index++] = (GLushort)qRound(qBound(0.0f, value, 1.0f)*65535.0f);
+                }
+            }
+        }
+        gl->glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, first, size[0], size[1], layers,
+                            GL_RED, GL_UNSIGNED_SHORT, texels.data());
+    }
+    gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    gl->glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void volumeAssetJob::destroy()
+{
+    QOpenGLContext::currentContext()->functions()->glDeleteTextures(1, &texture);
+}
+
+void GLRenderer::pushVolume()
+{
+    volumeAssetJob *job = new volumeAssetJob;
+    job->data   = dataPtr;
+    job->minmag = minmag;
+    job->maxmag = maxmag;
+    job->maxSize = 0;
+    glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &job->maxSize);
+    submitAsset(job);
+    volumeDirty = false;
+}
+
+void GLRenderer::drawVolume()
+{
+    // Rays are bounded by the cells left visible by the slice sliders
+    QVector<int> size = dataPtr->field->shape();
+    QVector3D center(xcom, ycom, zcom);
+    QVector3D slLo, slHi;
+    sliceBox(slLo, slHi);
+    for (int axis=0; axis<3; axis++) {
+        slLo[axis] = qBound(0.0f, ceilf(slLo[axis]),  (float)(size[axis]-1));
+        slHi[axis] = qBound(0.0f, floorf(slHi[axis]), (float)(size[axis]-1));
+        if (slHi[axis] < slLo[axis]) {
+            return;
+        }
+    }
+
+    setShaderUniforms(&volumeShader);
+    volumeShader.setUniformValue("box_low",     2.0f*(slLo - center) - QVector3D(1.0f, 1.0f, 1.0f));
+    volumeShader.setUniformValue("box_high",    2.0f*(slHi - center) + QVector3D(1.0f, 1.0f, 1.0f));
+    volumeShader.setUniformValue("eye",         view.inverted().map(QVector3D(0.0f, 0.0f, 0.0f)));
+    // Cells the texture spans, past the grid where the step doesn't divide it
+    volumeShader.setUniformValue("volume_size", QVector3D(volumeTexels[0], volumeTexels[1], volumeTexels[2])*volumeStep);
+    volumeShader.setUniformValue("density",     volumeDensity);
+    volumeShader.setUniformValue("volume",      0);
+
+    gl330Funcs->glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, volumeTexture);
+
+    // Back faces of the box, so the camera may sit inside it
+    glCullFace( GL_FRONT );
+    glDepthMask( GL_FALSE );
+    glEnable( GL_BLEND );
+    glBlendFunc( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+    cube.vao->bind();
+    glDrawElements( GL_TRIANGLES, cube.lods[0].count, GL_UNSIGNED_INT, 0 );
+    cube.vao->release();
+    glDisable( GL_BLEND );
+    glDepthMask( GL_TRUE );
+    glCullFace( GL_BACK );
+
+    glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void GLRenderer::setVolumeMode(bool on)
+{
+    volumeMode  = on;
+    requestRender();
+}
+
+bool GLRenderer::useFieldLines()
+{
+    return fieldLineSeeds != "Off" && displayOn && valuedim == 3 && fieldLineVao;
+}
+
+// Field lines traced through the slice box, as line strips
+class fieldLineAssetJob : public assetJob
+{
+public:
+    fieldLineAssetJob() : assetJob(fieldLineKind) {}
+    void extract();
+    void upload();
+    void destroy();
+
+    QSharedPointer<OMFReader> data;
+    QVector3D low, high; // Slice box
+    bool grid;           // Seeded through the volume, else on a plane
+    float invScale;
+    QList<fieldLineCacheEntry> *cache; // Only touched on the builder thread
+    std::vector<fieldLineVertex> vertices;
+    QVector<GLint> firsts;
+    QVector<GLsizei> counts;
+    QOpenGLBuffer vbo;
+};
+
+void fieldLineAssetJob::extract()
+{
+    QVector<float> key;
+    key << low.x() << low.y() << low.z() << high.x() << high.y() << high.z() << grid;
+
+    int cached = -1;
+    for (int i=0; i<cache->size(); i++) {
+        if ((*cache)[i].frame == data && (*cache)[i].key == key) {
+            cached = i;
+            break;
+        }
+    }
+
+    if (cached >= 0) {
+        cache->move(cached, 0);
+    } else {
+        // Seed spacing such that about fieldLineSeedCount lines are traced
+        QVector<int> size = data->field->shape();
+        QVector3D extent;
+        for (int axis=0; axis<3; axis++) {
+            extent[axis] = qMin(high[axis], (float)(size[axis]-1)) - qMax(low[axis], 0.0f) + 1.0f;
+        }
+
+        fieldLineTracer tracer(data->field, low, high);
+        QVector<QVector3D> seeds;
+        if (grid) {
+            float cells = qMax(extent.x()*extent.y()*extent.z(), 1.0f);
+            seeds = tracer.gridSeeds(qMax(2, (int)ceilf(powf(cells/fieldLineSeedCount, 1.0f/3.0f))));
+        } else {
+            float cells = qMax(extent.x()*extent.y(), 1.0f);
+            seeds = tracer.planeSeeds(qMax(2, (int)ceilf(sqrtf(cells/fieldLineSeedCount))));
+        }
+        QVector<fieldLine> lines = tracer.trace(seeds);
+
+        fieldLineCacheEntry entry;
+        entry.frame = data;
+        entry.key   = key;
+        for (int l=0; l<lines.size(); l++) {
+            const fieldLine &line = lines[l];
+            if (line.points.size() < 2) {
+                continue;
+            }
+            entry.firsts << (GLint)entry.vertices.size();
+            entry.counts << (GLsizei)line.points.size();
+            for (int i=0; i<line.points.size(); i++) {
+                QVector3D m = line.values[i] * invScale;
+                fieldLineVertex vertex = { line.points[i].x(), line.points[i].y(), line.points[i].z(),
+                                           { packSnorm16(m.x()), packSnorm16(m.y()), packSnorm16(m.z()) } };
+                entry.vertices.push_back(vertex);
+            }
+        }
+        cache->prepend(entry);
+        while (cache->size() > fieldLineCacheSize) {
+            cache->removeLast();
+        }
+    }
+
+    const fieldLineCacheEntry &entry = cache->first();
+    if (!bufferFits(entry.vertices.size(), sizeof(fieldLineVertex))) {
+        qWarning() << "Field lines of" << (qint64)entry.vertices.size() << "points are too large for one buffer";
+        return;
+    }
+    vertices = entry.vertices;
+    firsts   = entry.firsts;
+    counts   = entry.counts;
+}
+
+void fieldLineAssetJob::upload()
+{
+    if (vertices.empty()) {
+        return;
+    }
+    vbo = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    vbo.create();
+    vbo.bind();
+    vbo.allocate(&vertices[0], vertices.size()*sizeof(fieldLineVertex));
+    vbo.release();
+    std::vector<fieldLineVertex>().swap(vertices);
+}
+
+void fieldLineAssetJob::destroy()
+{
+    vbo.destroy();
+}
+
+void GLRenderer::pushFieldLines()
+{
+    fieldLinesDirty = false;
+
+    fieldLineAssetJob *job = new fieldLineAssetJob;
+    job->data     = dataPtr;
+    sliceBox(job->low, job->high);
+    job->grid     = (fieldLineSeeds == "Grid");
+    job->invScale = 1.0f/instanceScale;
+    job->cache    = &fieldLineCache;
+    submitAsset(job);
+}
+
+void GLRenderer::drawFieldLines()
+{
+    if (fieldLineCounts.isEmpty()) {
+        return;
+    }
+    setShaderUniforms(&fieldLineShader);
+    fieldLineVao->bind();
+    gl330Funcs->glMultiDrawArrays(GL_LINE_STRIP, fieldLineFirsts.constData(), fieldLineCounts.constData(),
+                                  fieldLineCounts.size());
+    fieldLineVao->release();
+}
+
+void GLRenderer::setFieldLineSeeds(QString value)
+{
+    fieldLineSeeds  = value;
+    fieldLinesDirty = true;
+    requestRender();
+}
+
+bool GLRenderer::useIsosurface()
+{
+    // Extraction samples the whole field into memory
+    return isoComponent != "Off" && displayOn && isoVao && dataPtr->field->shape()[2] > 1 && !streamed();
+}
+
+// Isosurface of one component through the slice box
+class isoAssetJob : public assetJob
+{
+public:
+    isoAssetJob() : assetJob(isoKind), indexCount(0) {}
+    void extract();
+    void upload();
+    void destroy();
+
+    QSharedPointer<OMFReader> data;
+    int component;
+    float offset, scale, iso;
+    int isoValue;        // Slider position, for the cache
+    QVector3D low, high; // Slice box
+    float invScale;
+    QList<isoCacheEntry> *cache; // Only touched on the builder thread, as is sampling
+    isoSampling *sampling;
+    std::vector<isoVertex> vertices;
+    std::vector<GLuint> indices;
+    int indexCount;
+    QOpenGLBuffer vbo, ibo;
+};
+
+void isoAssetJob::extract()
+{
+    QVector<float> key;
+    key << component << isoValue << low.x() << low.y() << low.z() << high.x() << high.y() << high.z();
+
+    int cached = -1;
+    for (int i=0; i<cache->size(); i++) {
+        if ((*cache)[i].frame == data && (*cache)[i].key == key) {
+            cached = i;
+            break;
+        }
+    }
+
+    if (cached >= 0) {
+        cache->move(cached, 0);
+    } else {
+        // Sampling is shared by every iso-value of the same frame and component
+        if (sampling->frame != data || sampling->component != component) {
+            sampling->extractor = QSharedPointer<isosurfaceExtractor>(
+                        new isosurfaceExtractor(data->field, component, offset, scale));
+            sampling->frame     = data;
+            sampling->component = component;
+        }
+        isoMesh mesh = sampling->extractor->extract(iso, low, high);
+
+        isoCacheEntry entry;
+        entry.frame = data;
+        entry.key   = key;
+        entry.vertices.reserve(mesh.positions.size());
+        for (int i=0; i<mesh.positions.size(); i++) {
+            QVector3D m = mesh.values[i] * invScale;
+            isoVertex vertex = { mesh.positions[i].x(), mesh.positions[i].y(), mesh.positions[i].z(),
+                                 mesh.normals[i].x(), mesh.normals[i].y(), mesh.normals[i].z(),
+                                 { packSnorm16(m.x()), packSnorm16(m.y()), packSnorm16(m.z()) } };
+            entry.vertices.push_back(vertex);
+        }
+        entry.indices.assign(mesh.indices.begin(), mesh.indices.end());
+        cache->prepend(entry);
+        while (cache->size() > isoCacheSize) {
+            cache->removeLast();
+        }
+    }
+
+    const isoCacheEntry &entry = cache->first();
+    if (!bufferFits(entry.vertices.size(), sizeof(isoVertex)) || !bufferFits(entry.indices.size(), sizeof(GLuint))) {
+        qWarning() << "Isosurface of" << (qint64)entry.indices.size()/3 << "triangles is too large for one buffer";
+        return;
+    }
+    vertices   = entry.vertices;
+    indices    = entry.indices;
+    indexCount = indices.size();
+}
+
+void isoAssetJob::upload()
+{
+    if (indices.empty()) {
+        return;
+    }
+    vbo = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    ibo = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+    vbo.create();
+    ibo.create();
+    vbo.bind();
+    vbo.allocate(&vertices[0], vertices.size()*sizeof(isoVertex));
+    vbo.release();
+    ibo.bind();
+    ibo.allocate(&indices[0], indices.size()*sizeof(GLuint));
+    ibo.release();
+    std::vector<isoVertex>().swap(vertices);
+    std::vector<GLuint>().swap(indices);
+}
+
+void isoAssetJob::destroy()
+{
+    vbo.destroy();
+    ibo.destroy();
+}
+
+void GLRenderer::pushIsosurface()
+{
+    isoDirty = false;
+
+    // Components relative to the largest magnitude, scalars between their extremes
+    isoAssetJob *job = new isoAssetJob;
+    float fraction = isoValue/1600.0f;
+    job->component = 2;
+    if (valuedim == 1) {
+        job->component = 0;
+        job->offset    = minmag;
+        job->scale     = (maxmag > minmag) ? 1.0f/(maxmag - minmag) : 1.0f;
+        job->iso       = fraction;
+    } else {
+        if (isoComponent == "X") {
+            job->component = 0;
+        } else if (isoComponent == "Y") {
+            job->component = 1;
+        }
+        job->offset = 0.0f;
+        job->scale  = (maxmag > 0.0f) ? 1.0f/maxmag : 1.0f;
+        job->iso    = 2.0f*fraction - 1.0f;
+    }
+    job->data     = dataPtr;
+    job->isoValue = isoValue;
+    sliceBox(job->low, job->high);
+    job->invScale = 1.0f/instanceScale;
+    job->cache    = &isoCache;
+    job->sampling = &isoSamples;
+    submitAsset(job);
+}
+
+void GLRenderer::drawIsosurface()
+{
+    if (isoIndices == 0) {
+        return;
+    }
+    setShaderUniforms(&isoShader);
+
+    // Both sides are lit, see iso.frag
+    glDisable( GL_CULL_FACE );
+    isoVao->bind();
+    glDrawElements(GL_TRIANGLES, isoIndices, GL_UNSIGNED_INT, 0);
+    isoVao->release();
+    glEnable( GL_CULL_FACE );
+}
+
+void GLRenderer::setIsoComponent(QString value)
+{
+    isoComponent = value;
+    isoDirty     = true;
+    requestRender();
+}
+
+void GLRenderer::setIsoValue(int value)
+{
+    if (isoValue != value) {
+        isoValue    = value;
+        isoDirty    = true;
+        requestRender();
+    }
+}
+
+void GLRenderer::pushAssets()
+{
+    // Extracted and uploaded on the builder thread, and drawn once they are
+    // back, so the draw pass never waits for a mesh or texture
+    if (!displayOn || pos_vbos.isEmpty()) {
+        return;
+    }
+    makeContextCurrent();
+    bool cubes = valuedim == 1 || displayObject == &cube;
+    if (isFilm() && filmDirty) {
+        pushFilm();
+    }
+    if (useVolume() && volumeDirty) {
+        pushVolume();
+    }
+    if (cubes && useSurface() && !useVolume() && !isFilm() && surfaceDirty) {
+        pushSurface();
+    }
+    if (useFieldLines() && fieldLinesDirty) {
+        pushFieldLines();
+    }
+    if (useIsosurface() && isoDirty) {
+        pushIsosurface();
+    }
+}
+
+void GLRenderer::submitAsset(assetJob *job)
+{
+    job->generation = ++pushedAssets[job->kind];
+    builder->submit(job);
+}
+
+void GLRenderer::waitInstances()
+{
+    // The level requested last, else the frame shown so far stays
+    makeContextCurrent();
+    instanceFrame *frame = builder->waitFinal(pushedGeneration, builderTimeout);
+    if (frame) {
+        adoptInstances(frame);
+    } else {
+        qWarning() << "Gave up waiting for the builder thread, the image may show a coarser level";
+    }
+}
+
+void GLRenderer::waitAssets()
+{
+    // Exported frames are never drawn with the meshes of another frame
+    for (int kind=0; kind<assetKinds; kind++) {
+        if (shownAssets[kind] == pushedAssets[kind]) {
+            continue;
+        }
+        assetJob *job = builder->waitAsset((assetKind)kind, pushedAssets[kind], builderTimeout);
+        if (job) {
+            adoptAsset(job);
+        } else {
+            qWarning() << "Gave up waiting for the builder thread, the image may show stale meshes";
+        }
+    }
+}
+
+void GLRenderer::adoptAsset(assetJob *job)
+{
+    // Jobs of superseded pushes are dropped
+    makeContextCurrent();
+    if (job->generation != pushedAssets[job->kind]) {
+        builder->discardAsset(job);
+        return;
+    }
+    shownAssets[job->kind] = job->generation;
+
+    // Uploaded here when the builder thread has no context of its own.
+    // Index buffers bind to the vertex array bound, which is re-pointed below.
+    if (!job->isUploaded) {
+        QOpenGLVertexArrayObject *vao = 0;
+        if (job->kind == surfaceKind) {
+            vao = surfaceVao;
+        } else if (job->kind == isoKind) {
+            vao = isoVao;
+        }
+        if (vao) {
+            vao->bind();
+        }
+        job->upload();
+        if (vao) {
+            vao->release();
+        }
+    }
+    // Draws from here on wait on the GPU for the upload
+    if (job->uploaded) {
+        gl330Funcs->glWaitSync(job->uploaded, 0, GL_TIMEOUT_IGNORED);
+        gl330Funcs->glDeleteSync(job->uploaded);
+    }
+
+    // The objects drawn so far are deleted once the draws from them are done
+    if (job->kind == filmKind) {
+        filmAssetJob *film = static_cast<filmAssetJob *>(job);
+        glDeleteTextures(1, &filmTexture);
+        filmTexture = film->texture;
+        filmStep    = film->step;
+    } else if (job->kind == volumeKind) {
+        volumeAssetJob *volume = static_cast<volumeAssetJob *>(job);
+        glDeleteTextures(1, &volumeTexture);
+        volumeTexture = volume->texture;
+        volumeTexels  = volume->size;
+        volumeStep    = volume->step;
+    } else if (job->kind == surfaceKind) {
+        surfaceAssetJob *surface = static_cast<surfaceAssetJob *>(job);
+        if (surface->vbo.isCreated()) {
+            surface_vbo.destroy();
+            surface_ibo.destroy();
+            surface_vbo = surface->vbo;
+            surface_ibo = surface->ibo;
+            bindSurfaceBuffers();
+        }
+        surfaceIndices = surface->indexCount;
+    } else if (job->kind == fieldLineKind) {
+        fieldLineAssetJob *lines = static_cast<fieldLineAssetJob *>(job);
+        if (lines->vbo.isCreated()) {
+            fieldline_vbo.destroy();
+            fieldline_vbo = lines->vbo;
+            bindFieldLineBuffers();
+        }
+        fieldLineFirsts = lines->firsts;
+        fieldLineCounts = lines->counts;
+    } else if (job->kind == isoKind) {
+        isoAssetJob *iso = static_cast<isoAssetJob *>(job);
+        if (iso->vbo.isCreated()) {
+            iso_vbo.destroy();
+            iso_ibo.destroy();
+            iso_vbo = iso->vbo;
+            iso_ibo = iso->ibo;
+            bindIsoBuffers();
+        }
+        isoIndices = iso->indexCount;
+    }
+    delete job;
+    needsUpdate = true;
+}
+
+void GLRenderer::setFilmMode(bool on)
+{
+    filmMode    = on;
+    filmDirty   = true;
+    needsPush   = true;
+    requestRender();
+}
+
+void GLRenderer::updateExtent()
+{
+    QVector<int> size = dataPtr->field->shape();
+    xmax = size[0];
+    ymax = size[1];
+    zmax = size[2];
+    xmin = 0.0;
+    ymin = 0.0;
+    zmin = 0.0;
+}
+
+void GLRenderer::requestRender()
+{
+    needsUpdate = true;
+    scheduleFrame();
+}
+
+void GLRenderer::scheduleFrame()
+{
+    // Requests made before the frame is drawn are coalesced into it, and
+    // frames are paced to the refresh rate so swaps never queue up
+    if (renderTimer->isActive()) {
+        return;
+    }
+    qint64 interval = (qint64)(1000.0/refreshRate);
+    qint64 wait = 0;
+    if (lastFrame.isValid()) {
+        wait = qMax((qint64)0, interval - lastFrame.elapsed());
+    }
+    renderTimer->start((int)wait);
+}
+
+void GLRenderer::update() {
+    // Instances and assets the builder thread finished since the last frame
+    instanceFrame *frame = builder->take();
+    if (frame) {
+        adoptInstances(frame);
+    }
+    for (int kind=0; kind<assetKinds; kind++) {
+        assetJob *job = builder->takeAsset((assetKind)kind);
+        if (job) {
+            adoptAsset(job);
+        }
+    }
+    if (needsUpdate) {
+        lastFrame.start();
+        adaptQuality();
+        // Zooming a thin film changes the stride of its glyph overlay
+        updateView();
+        int pushed = refining ? refineLevel : pushedSubsampling;
+        if (isFilm() && qMax(subsampling + extraSubsampling(), filmSubsampling()) != pushed) {
+            needsPush = true;
+        }
+        // Moving the slice box of streamed data brings in other bricks
+        if (streamed()) {
+            QVector3D slLo, slHi;
+            sliceBox(slLo, slHi);
+            if (slLo != pushedSliceLow || slHi != pushedSliceHigh) {
+                needsPush = true;
+            }
+        }
+        if (needsPush) {
+            pushBuffers();
+        }
+        // Exported frames wait for the requested level
+        if (refining && !progressive) {
+            waitInstances();
+        }
+        pushAssets();
+        if (!progressive) {
+            waitAssets();
+        }
+        render();
+        needsUpdate = false;
+        emit doneRenderingFrame(filename);
+    }
+}
+
+void GLRenderer::renderFrame(QString file)
+{
+    filename = file;
+    needsUpdate = true;
+    // Exported frames are never left at a coarse preview
+    if (interacting) {
+        settleQuality();
+    }
+    progressive = false;
+    update();
+    progressive = true;
+}
+
+void GLRenderer::initialize()
+{
+    qDebug() << "Really used OpenGl: " << glContext->format().majorVersion() << "." << glContext->format().minorVersion();
+    qDebug() << "OpenGl information: VENDOR:       " << (const char*)glGetString(GL_VENDOR);
+    qDebug() << "                    RENDERDER:    " << (const char*)glGetString(GL_RENDERER);
+    qDebug() << "                    VERSION:      " << (const char*)glGetString(GL_VERSION);
+    qDebug() << "                    GLSL VERSION: " << (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION);
+
+    // gl330Funcs = 0;
+    // gl330Funcs = context()->versionFunctions<QOpenGLFunctions_3_3_Core>();
+    gl330Funcs = new QOpenGLFunctions_3_3_Core;
+    if (gl330Funcs)
+        gl330Funcs->initializeOpenGLFunctions();
+    else
+    {
+        qWarning() << "Could not obtain required OpenGL context version";
+        exit(1);
+    }
+
+    initializeAssets();
+    initializeFrameQueries();
+    pushLUT(); // Set before the programs were linked
+    initialized = true;
+    qDebug() << "Shaders and meshes ready after" << startupTimer.elapsed() << "ms";
+
+    if ( surface->surfaceClass() == QSurface::Window && surface->format().samples() <= 0 )
+        qWarning() << "Could not enable sample buffers";
+
+    glClearColor( backgroundColor.redF(), backgroundColor.greenF(), backgroundColor.blueF(), backgroundColor.alphaF() );
+
+    glEnable( GL_MULTISAMPLE );
+    glEnable( GL_DEPTH_TEST );
+    glEnable( GL_CULL_FACE );
+    glEnable( GL_SMOOTH );
+    glDepthFunc( GL_LEQUAL );
+}
+
+void GLRenderer::resize( int w, int h )
+{
+    // Set the viewport to window dimensions, at the next frame
+    viewportWidth  = qMax( w, 1 );
+    viewportHeight = qMax( h, 1 );
+    qreal aspect = qreal(w) / qreal(h ? h : 1);
+    projection.setToIdentity();
+    projection.perspective(45.0f,aspect,0.1f,10000.0f);
+
+    requestRender();
+}
+
+void GLRenderer::render()
+{
+    if (!initialized || !makeContextCurrent()) {
+        return;
+    }
+    paint();
+    if (surface->surfaceClass() == QSurface::Window) {
+        glContext->swapBuffers(surface);
+    }
+    if (startupTimer.isValid()) {
+        qDebug() << "Time to first frame:" << startupTimer.elapsed() << "ms";
+        startupTimer.invalidate();
+    }
+}
+
+void GLRenderer::paint()
+{
+    // Timed for the quality controller, see adaptQuality
+    glViewport( 0, 0, viewportWidth, viewportHeight );
+    beginFrameQuery();
+    if (renderScale < 1.0f && bindSceneFramebuffer()) {
+        drawScene();
+        drawUpscaled();
+    } else {
+        drawScene();
+    }
+    endFrameQuery();
+
+}
+
+void GLRenderer::drawScene()
+{
+    // Clear the buffer with the current clearing color
+    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+
+    if (displayOn) {
+        sprite *tempSprite;
+        QOpenGLShaderProgram *tempShader;
+
+        updateView();
+
+        // Whatever the builder thread has uploaded so far, see pushAssets
+        if (useFieldLines()) {
+            drawFieldLines();
+        }
+
+        if (useIsosurface()) {
+            drawIsosurface();
+        }
+
+        if (valuedim == 1 ) {
+            tempSprite = &cube;
+            tempShader = &cubeShader;
+        } else {
+            tempSprite = displayObject;
+            tempShader = currentShader;
+        }
+
+        if (useVolume()) {
+            drawVolume();
+            return;
+        }
+
+        if (isFilm()) {
+            // The colour map comes from the film texture, glyphs (other
+            // than cubes, which would hide it) are only an overlay
+            drawFilm();
+            if (tempSprite == &cube) {
+                return;
+            }
+        }
+
+        if (tempSprite == &cube && useSurface()) {
+            if (surfaceIndices > 0) {
+                drawSurface();
+                return;
+            }
+        }
+
+        buildGlyph(tempSprite);
+        drawSprite(tempSprite, tempShader);
+    }
+}
+
+void GLRenderer::updateView()
+{
+    view.setToIdentity();
+    view.translate(xLoc, yLoc, zoom);
+    view.rotate(xRot / 1600.0, 1.0, 0.0, 0.0);
+    view.rotate(yRot / 1600.0, 0.0, 1.0, 0.0);
+    view.rotate(zRot / 1600.0, 0.0, 0.0, 1.0);
+}
+
+void GLRenderer::sliceBox(QVector3D &low, QVector3D &high)
+{
+    // Grid coordinates of the cells left visible by the slice sliders
+    low  = QVector3D((xmax-xmin)*(GLfloat)xSliceLow/1600.0,
+                     (ymax-ymin)*(GLfloat)ySliceLow/1600.0,
+                     (zmax-zmin)*(GLfloat)zSliceLow/1600.0);
+    high = QVector3D((xmax-xmin)*(GLfloat)xSliceHigh/1600.0,
+                     (ymax-ymin)*(GLfloat)ySliceHigh/1600.0,
+                     (zmax-zmin)*(GLfloat)zSliceHigh/1600.0);
+}
+
+void GLRenderer::setShaderUniforms(QOpenGLShaderProgram *shader)
+{
+    GLfloat thrLo = ((GLfloat)thresholdLow)/1600.0;
+    GLfloat thrHi = ((GLfloat)thresholdHigh)/1600.0;
+    GLfloat sc    = (GLfloat)(1 << pushedSubsampling);
+    QVector3D slLo, slHi;
+    sliceBox(slLo, slHi);
+
+    shader->bind();
+    shader->setUniformValue("view",              view);
+    shader->setUniformValue("projection",        projection);
+    shader->setUniformValue("brightness",        brightness);
+    shader->setUniformValue("light.position",    lightPosition);
+    shader->setUniformValue("light.intensities", lightIntensity);
+    shader->setUniformValue("ambient",           lightAmbient);
+    shader->setUniformValue("maxmag",            maxmag/instanceScale);
+    shader->setUniformValue("thresholdLow",      thrLo);
+    shader->setUniformValue("thresholdHigh",     thrHi);
+    shader->setUniformValue("xSliceLow",         slLo.x());
+    shader->setUniformValue("xSliceHigh",        slHi.x());
+    shader->setUniformValue("ySliceLow",         slLo.y());
+    shader->setUniformValue("ySliceHigh",        slHi.y());
+    shader->setUniformValue("zSliceLow",         slLo.z());
+    shader->setUniformValue("zSliceHigh",        slHi.z());
+    shader->setUniformValue("display_type",      display_type_map[coloredQuantity]);
+    shader->setUniformValue("use_color_lut",     (colorScale !=  "HSL") ? 1 : 0);
+    shader->setUniformValue("com",               QVector3D(xcom, ycom, zcom));
+    shader->setUniformValue("do_rotate",         (displayObject == &cube) ? 0 : 1);
+    shader->setUniformValue("valuedim",          valuedim);
+    shader->setUniformValue("scale",             sc);
+}
+
+void GLRenderer::drawSprite(sprite *object, QOpenGLShaderProgram *shader)
+{
+    GLfloat sc = (GLfloat)(1 << pushedSubsampling);
+    setShaderUniforms(shader);
+
+    if (shader == &impostorShader) {
+        // Same arrow profile as initializeVect
+        float height = 5.0f*vectorLength;
+        float tail   = (vectorOrigin == "Tail") ? 0.0f : -0.5f*height;
+        shader->setUniformValue("glyph_tail",   tail);
+        shader->setUniformValue("glyph_neck",   tail + height*(1.0f-vectorTipLengthRatio));
+        shader->setUniformValue("glyph_head",   tail + height);
+        shader->setUniformValue("glyph_radius", vectorRadius);
+        shader->setUniformValue("glyph_shaft",  vectorRadius*vectorShaftRadiusRatio);
+    }
+
+    if (object == &points) {
+        // Size the points to roughly fill one (subsampled) cell at the center of mass
+        glPointSize(qBound(1.0f, sc*cellPixels(), 16.0f));
+    }
+
+    // Vertex Array, already pointing at the shared instance buffers
+    object->vao->bind();
+
+    // Frustum planes from the rows of projection*view
+    QMatrix4x4 clip = projection * view;
+    instanceVisit visit;
+    visit.planes[0] = clip.row(3) + clip.row(0);
+    visit.planes[1] = clip.row(3) - clip.row(0);
+    visit.planes[2] = clip.row(3) + clip.row(1);
+    visit.planes[3] = clip.row(3) - clip.row(1);
+    visit.planes[4] = clip.row(3) + clip.row(2);
+    visit.planes[5] = clip.row(3) - clip.row(2);
+    sliceBox(visit.sliceLow, visit.sliceHigh);
+    visit.eye = 0.5f*view.inverted().map(QVector3D(0.0f, 0.0f, 0.0f)) + QVector3D(xcom, ycom, zcom);
+    visit.sc  = sc;
+    visit.pad = object->extent*sc;
+    visit.run.count = 0;
+    visit.run.lod   = 0;
+
+    if (!instanceNodes.isEmpty()) {
+        drawInstanceNode(*object, 0, visit);
+    }
+    flushInstanceRun(*object, visit.run);
+    setInstanceOffset(0);
+
+    object->vao->release();
+}
+
+// Whether a box is outside (-1), straddling (0) or inside (1) the frustum
+static int classifyBox(const QVector4D planes[6], const QVector3D &low, const QVector3D &high)
+{
+    int result = 1;
+    for (int p=0; p<6; p++) {
+        const QVector4D &plane = planes[p];
+        QVector3D normal = plane.toVector3D();
+        QVector3D farthest(plane.x() >= 0.0f ? high.x() : low.x(),
+                           plane.y() >= 0.0f ? high.y() : low.y(),
+                           plane.z() >= 0.0f ? high.z() : low.z());
+        QVector3D nearest(plane.x() >= 0.0f ? low.x() : high.x(),
+                          plane.y() >= 0.0f ? low.y() : high.y(),
+                          plane.z() >= 0.0f ? low.z() : high.z());
+        if (QVector3D::dotProduct(normal, farthest) + plane.w() < 0.0f) {
+            return -1;
+        }
+        if (QVector3D::dotProduct(normal, nearest) + plane.w() < 0.0f) {
+            result = 0;
+        }
+    }
+    return result;
+}
+
+void GLRenderer::drawInstanceNode(const sprite &object, int index, instanceVisit &visit)
+{
+    const instanceNode &node = instanceNodes[index];
+    if (node.count == 0) {
+        return;
+    }
+
+    // Cells outside the slice box would be discarded by the shaders anyway
+    for (int axis=0; axis<3; axis++) {
+        if (node.high[axis] < visit.sliceLow[axis] || node.low[axis] > visit.sliceHigh[axis]) {
+            return;
+        }
+    }
+
+    QVector3D center(xcom, ycom, zcom);
+    QVector3D pad(visit.pad, visit.pad, visit.pad);
+    int frustum = classifyBox(visit.planes, 2.0f*(node.low - center) - pad, 2.0f*(node.high - center) + pad);
+    if (frustum < 0) {
+        return;
+    }
+
+    // Whole nodes in view at a single level of detail go in one piece
+    bool leaf = true;
+    for (int c=0; c<8; c++) {
+        leaf = leaf && node.children[c] < 0;
+    }
+    int lod = chooseLOD(object, node.low, node.high, visit.sc, true);
+    if (leaf || (frustum > 0 && lod == chooseLOD(object, node.low, node.high, visit.sc, false))) {
+        appendInstanceRun(object, node.first, node.count, lod, visit.run);
+        return;
+    }
+
+    // Otherwise children nearest the eye first, for early depth rejection
+    int order[8];
+    float distance[8];
+    int numChildren = 0;
+    for (int c=0; c<8; c++) {
+        int child = node.children[c];
+        if (child < 0) {
+            continue;
+        }
+        float d = (0.5f*(instanceNodes[child].low + instanceNodes[child].high) - visit.eye).lengthSquared();
+        int i = numChildren++;
+        while (i > 0 && distance[i-1] > d) {
+            order[i]    = order[i-1];
+            distance[i] = distance[i-1];
+            i--;
+        }
+        order[i]    = child;
+        distance[i] = d;
+    }
+    for (int i=0; i<numChildren; i++) {
+        drawInstanceNode(object, order[i], visit);
+    }
+}
+
+void GLRenderer::appendInstanceRun(const sprite &object, qint64 first, qint64 count, int lod, instanceRun &run)
+{
+    if (run.count > 0 && run.lod == lod && run.first + run.count == first) {
+        run.count += count;
+        return;
+    }
+    flushInstanceRun(object, run);
+    run.first = first;
+    run.count = count;
+    run.lod   = lod;
+}
+
+void GLRenderer::flushInstanceRun(const sprite &object, instanceRun &run)
+{
+    // There is no base instance in GL 3.3, see setInstanceOffset.
+    // Runs crossing from one instance buffer into the next are split.
+    const spriteLOD &mesh = object.lods[run.lod];
+    while (run.count > 0) {
+        GLsizei count = (GLsizei)qMin(run.count, (qint64)setInstanceOffset(run.first));
+        gl330Funcs->glDrawElementsInstanced( object.mode, mesh.count, GL_UNSIGNED_INT,
+                                             reinterpret_cast<const void *>(mesh.offset * sizeof(GLuint)), count);
+        run.first += count;
+        run.count -= count;
+    }
+}
+
+float GLRenderer::cellPixels()
+{
+    // Approximate on-screen size of one cell (2 world units) at the
+    // center of mass, for the 45 degree field of view
+    QVector3D eye = view.map(QVector3D(0.0f, 0.0f, 0.0f));
+    float dist = qMax(0.1f, eye.length());
+    return 2.0f * 0.5f * viewportHeight / (dist * tan(22.5*PI/180.0));
+}
+
+int GLRenderer::chooseLOD(const sprite &object, const QVector3D &low, const QVector3D &high, float sc, bool nearest)
+{
+    if (object.lods.size() < 2) {
+        return 0;
+    }
+
+    // Closest (or farthest) corner of the box in eye coordinates, using
+    // the same placement as the vertex shaders: 2*(translation - com)
+    QVector3D center(xcom, ycom, zcom);
+    float depth = nearest ? 1.0e30f : -1.0e30f;
+    for (int c=0; c<8; c++) {
+        QVector3D corner((c & 1) ? high.x() : low.x(),
+                         (c & 2) ? high.y() : low.y(),
+                         (c & 4) ? high.z() : low.z());
+        QVector3D eye = view.map(2.0f*(corner - center));
+        depth = nearest ? qMin(depth, -eye.z()) : qMax(depth, -eye.z());
+    }
+    if (depth <= 0.1f) {
+        return 0;
+    }
+
+    // Size on screen of the largest glyph in the range, 45 degree field of view
+    float pixels = object.extent * sc * 0.5f * viewportHeight / (depth * tan(22.5*PI/180.0));
+    int lod = 0;
+    while (lod < 2 && pixels < lodPixelSize[lod]) {
+        lod++;
+    }
+    return qMin(lod + lodBias(), object.lods.size()-1);
+}
+
+void GLRenderer::toggleDisplay(int type)
+{
+    displayType = type;
+    if (displayType == 0) {
+        displayObject = &cube;
+        currentShader = &cubeShader;
+    } else if (displayType == 1) {
+        displayObject = &cone;
+        currentShader = &standardShader;
+    } else if (displayType == 2) {
+        displayObject = &vect;
+        currentShader = &standardShader;
+    } else if (displayType == 3) {
+        displayObject = &impostor;
+        currentShader = &impostorShader;
+    } else if (displayType == 4) {
+        displayObject = &lines;
+        currentShader = &flatShader;
+    } else {
+        displayObject = &points;
+        currentShader = &flatShader;
+    }
+    requestRender();
+}
+
+void GLRenderer::setBackgroundColor(QColor color) {
+    backgroundColor = color;
+    if (makeContextCurrent()) {
+        glClearColor(backgroundColor.redF(), backgroundColor.greenF(), backgroundColor.blueF(), backgroundColor.alphaF());
+    }
+    requestRender();
+}
+
+void GLRenderer::setSpriteDimensions(int newslices, float length, float radius, float tipLengthRatio, float shaftRadiusRatio, QString origin)
+{
+    if ( (slices != newslices) || (vectorLength != length) || (vectorRadius != radius) ||
+         (vectorTipLengthRatio != tipLengthRatio) || (vectorShaftRadiusRatio != shaftRadiusRatio) ||
+         (vectorOrigin != origin) )
+    {
+        slices = newslices;
+        vectorLength = length;
+        vectorRadius = radius;
+        vectorTipLengthRatio = tipLengthRatio;
+        vectorShaftRadiusRatio = shaftRadiusRatio;
+        vectorOrigin = origin;
+        vect.stale  = true;
+        cone.stale  = true;
+        lines.stale = true;
+        requestRender();
+    }
+}
+
+void GLRenderer::setBrightness(float bright)
+{
+    brightness = bright;
+    requestRender();
+}
+
+void GLRenderer::setColoredQuantity(QString value)
+{
+    coloredQuantity = value;
+    surfaceDirty = true; // Merged faces depend on the colouring
+}
+
+void GLRenderer::setColorScale(QString value)
+{
+    colorScale = value;
+    surfaceDirty = true;
+    pushLUT();
+}
+
+void GLRenderer::setSpriteScale(QString value)
+{
+    spriteScale = value;
+}
@@ -0,0 +1,468 @@
+#ifndef GLRENDERER_H
+#define GLRENDERER_H
+#define PI 3.1415926535897932384626433832795
+
+#include <QImage>
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <vector>
+
+#include "matrix.h"
+#include "OMFImport.h"
+#include "fieldlines.h"
+#include "isosurface.h"
+#include "instancebuilder.h"
+
+// One tessellation of a glyph, as a range of its index buffer
+struct spriteLOD
+{
+    GLuint offset;
+    GLuint count;
+};
+
+struct sprite
+{
+    QOpenGLBuffer vbo;
+    QOpenGLBuffer ibo;
+    QOpenGLVertexArrayObject *vao;
+    QVector<spriteLOD> lods; // Finest first
+    float extent;            // Largest dimension of the glyph before scaling
+    GLenum mode;             // Primitive type
+    bool stale;              // Mesh is (re)built before its next draw
+};
+
+// Instances queued for one draw call, merged while contiguous
+struct instanceRun
+{
+    qint64 first;
+    qint64 count;
+    int lod;
+};
+
+// What the octree traversal needs to cull and order the bricks
+struct instanceVisit
+{
+    QVector4D planes[6];           // View frustum, in world coordinates
+    QVector3D sliceLow, sliceHigh; // Slice box, in grid coordinates
+    QVector3D eye;                 // In grid coordinates
+    float sc;                      // Glyph scale
+    float pad;                     // Glyph reach beyond a cell, in world coordinates
+    instanceRun run;
+};
+
+// One corner of an exposed cube face. The same attributes as an
+// instanced cube, but per vertex, so cube.vert can draw either.
+struct surfaceVertex
+{
+    GLfloat x, y, z;
+    GLfloat nx, ny, nz;
+    instanceVector   magnetization;
+    instancePosition translation;
+};
+
+// Exposed faces extracted for one frame and set of slice bounds
+struct surfaceCacheEntry
+{
+    QWeakPointer<OMFReader> frame;
+    QVector<float> key;
+    std::vector<surfaceVertex> vertices;
+};
+
+// Point on a traced field line and the field there
+struct fieldLineVertex
+{
+    GLfloat x, y, z;
+    instanceVector magnetization;
+};
+
+// Field lines traced for one frame and set of slice bounds
+struct fieldLineCacheEntry
+{
+    QWeakPointer<OMFReader> frame;
+    QVector<float> key;
+    std::vector<fieldLineVertex> vertices;
+    QVector<GLint> firsts;
+    QVector<GLsizei> counts;
+};
+
+// Isosurface vertex, in grid coordinates
+struct isoVertex
+{
+    GLfloat x, y, z;
+    GLfloat nx, ny, nz;
+    instanceVector magnetization;
+};
+
+// Isosurface extracted for one frame, iso-value and set of slice bounds
+struct isoCacheEntry
+{
+    QWeakPointer<OMFReader> frame;
+    QVector<float> key;
+    std::vector<isoVertex> vertices;
+    std::vector<GLuint> indices;
+};
+
+// Samples of the field shared by every iso-value of one frame and component
+struct isoSampling
+{
+    QSharedPointer<isosurfaceExtractor> extractor;
+    QWeakPointer<OMFReader> frame; // What extractor sampled
+    int component;
+};
+
+// Draws the scene into whatever surface it is given: the window of the
+// viewport, or an offscreen surface when exporting images without one.
+// Owns every GL object, so it only ever runs where its context is current:
+// on a thread of its own behind the viewport, see GLWidget.
+class GLRenderer : public QObject
+{
+    Q_OBJECT
+public:
+    GLRenderer( QObject* parent = 0 );
+    ~GLRenderer();
+
+    // Drawing target. The context must be set on the thread that created
+    // it, before the first surface, see instanceBuilder::shareContext
+    void setContext(QOpenGLContext *context);
+    bool isInitialized();
+
+    // Data and Drawing
+//    void updateHeader(QSharedPointer<OMFHeader> header, QSharedPointer<matrix> data);
+    void isDoneRendering();
+    virtual void renderFrame(QString file);
+    QImage renderImage(QSize size); // Offscreen, at any size
+
+public slots:
+    // Slots, so the viewport can queue them to the rendering thread
+    void updateData(QSharedPointer<OMFReader> data);
+    void requestImage(QSize size); // Answered by imageRendered
+    void moveToMainThread();       // With the context, before either is deleted
+
+    // View Preferences
+    virtual void toggleDisplay(int type);
+    virtual void setBackgroundColor(QColor color);
+    virtual void setSpriteDimensions(int newslices, float length, float radius, float tipLengthRatio, float shaftRadiusRatio, QString origin);
+    virtual void setBrightness(float bright);
+    void setColorScale(QString value);
+    void setSpriteScale(QString value);
+    void setColoredQuantity(QString value);
+    void setCustomColorScale(QList<QColor> colors);
+    void setUploadTolerance(float percent);
+    void setTargetFrameRate(int fps);
+    void setRenderScaleRange(float low, float high);
+
+    virtual void update();
+    void setSurface(QSurface *target); // Initializes GL on the first one
+    void resize(int w, int h);          // In device pixels
+    void requestRender();               // Redraw in the next frame
+    void setFilmMode(bool on);
+    void setSurfaceMode(bool on);
+    void setGreedyMode(bool on);
+    void setVolumeMode(bool on);
+    void setFieldLineSeeds(QString value);
+    void setIsoComponent(QString value);
+    void setIsoValue(int value);
+
+    // Movement and slicing
+    void setXRotation(int angle);
+    void setYRotation(int angle);
+    void setZRotation(int angle);
+    void setXSliceLow(int low);
+    void setYSliceLow(int low);
+    void setZSliceLow(int low);
+    void setThresholdLow(int low);
+    void setXSliceHigh(int high);
+    void setYSliceHigh(int high);
+    void setZSliceHigh(int high);
+    void setThresholdHigh(int high);
+    void setXCom(float val);
+    void setYCom(float val);
+    void setZCom(float val);
+    void setXLoc(float val);
+    void setYLoc(float val);
+    void setZLoc(float val);
+
+    // Subsampling
+    void increaseSubsampling();
+    void decreaseSubsampling();
+
+    // Mouse control, relative to the current view
+    void beginInteraction();
+    void rotateBy(int dx, int dy, int dz);
+    void moveBy(float dx, float dy);
+    void zoomBy(float delta);
+
+signals:
+    void xRotationChanged(int angle);
+    void yRotationChanged(int angle);
+    void zRotationChanged(int angle);
+    void COMChanged(float val);
+    void doneRenderingFrame(QString filename);
+    void instancesUploaded(float percent); // Of the instance data, at the last push
+    void imageRendered(QImage image);      // Null if it could not be drawn
+
+private slots:
+    void settleQuality();
+    void instancesReady();
+
+protected:
+    virtual void updateCOM();
+    virtual void updateExtent();
+
+    virtual void initialize();
+    virtual void paint();
+    void render(); // Paints and swaps
+    virtual void pushBuffers();
+    virtual void pushLUT();
+    virtual void pushFilm();
+    virtual void pushSurface();
+    virtual void pushVolume();
+    virtual void pushFieldLines();
+    virtual void pushIsosurface();
+
+    // Drawing passes
+    void updateView();
+    void setShaderUniforms(QOpenGLShaderProgram *shader);
+    void drawSprite(sprite *object, QOpenGLShaderProgram *shader);
+    void drawFilm();
+    void drawSurface();
+    void drawVolume();
+    void drawFieldLines();
+    void drawIsosurface();
+    void sliceBox(QVector3D &low, QVector3D &high);
+
+    // Film, volume, surface, field lines and isosurface are extracted and
+    // uploaded on the builder thread, see pushAssets
+    void pushAssets();
+    void submitAsset(assetJob *job);
+    void waitInstances(); // For exported frames
+    void waitAssets();
+    void adoptAsset(assetJob *job);
+    void bindSurfaceBuffers();
+    void bindFieldLineBuffers();
+    void bindIsoBuffers();
+
+    void sliceChanged();
+    float cellPixels();
+
+private:
+    // Drawing target
+    QOpenGLContext *glContext;
+    QSurface *surface;
+    bool initialized; // GL objects exist, see initialize
+    qreal refreshRate;
+
+    // Shaders
+    QOpenGLShaderProgram standardShader, cubeShader, impostorShader, flatShader, filmShader, volumeShader, fieldLineShader, isoShader, upscaleShader;
+    QOpenGLShaderProgram *currentShader;
+    QOpenGLFunctions_3_3_Core* gl330Funcs;
+
+    // Init functions
+    void initializeAssets();
+    bool initializeInstanceBuffers();
+    bool initializeShaders();
+    bool initializeLights();
+    bool initializeCube();
+    bool initializeImpostor();
+    bool initializePoints();
+    bool initializeLines(float height);
+    bool initializeFilm();
+    bool initializeSurface();
+    bool initializeVolume();
+    bool initializeFieldLines();
+    bool initializeIsosurface();
+    bool initializeCone(int slices, float radius, float height);
+    bool initializeVect(int slices, float height, float radius, float fractionTip, float fractionInner);
+    void buildGlyph(sprite *object);
+    bool initializeSprite(sprite &object, QOpenGLShaderProgram &shader,
+                          const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices,
+                          const QVector<spriteLOD> &lods, float extent, GLenum mode);
+    GLsizei setInstanceOffset(qint64 first);
+    int  chooseLOD(const sprite &object, const QVector3D &low, const QVector3D &high, float sc, bool nearest);
+    void adoptInstances(instanceFrame *frame);
+    void drawInstanceNode(const sprite &object, int index, instanceVisit &visit);
+    void appendInstanceRun(const sprite &object, qint64 first, qint64 count, int lod, instanceRun &run);
+    void flushInstanceRun(const sprite &object, instanceRun &run);
+    bool initializeInstanceAttributes();
+
+    float uploadTolerance; // Largest change of a vector component left out of an upload
+    QVector<instanceNode> instanceNodes; // Root first
+    float instanceScale; // Magnitude that maps to +/-1 in the snorm16 vectors
+
+    // Per-frame instance data, shared by the VAOs of every sprite.
+    // Split over several buffers when too large for a single one.
+    // Written by the instance builder, see adoptInstances.
+    QVector<QOpenGLBuffer> pos_vbos;
+    QVector<QOpenGLBuffer> mag_vbos;
+    int shownBuffers; // Set of the builder's buffers drawn from, -1 before the first
+
+    // Sprites and Data
+    sprite cube, cone, vect, impostor, lines, points;
+    sprite film;
+    sprite *displayObject;
+    qint64 numNodes; // Number of nodes being displayed with current subsampling
+    int displayType; // Cube 0, Cone 1, Vector 2, Impostor 3, Line 4, Point 5
+    int valuedim;    // scalar or vector
+    int subsampling; // display each 2^n'th cell according to this variable
+    int pushedSubsampling; // what the instance buffers were actually built with
+    QVector3D pushedSliceLow, pushedSliceHigh; // Slice box of streamed instance buffers
+    bool streamed(); // Data is mapped from disk rather than held in memory
+    bool packedPositionsFit(); // Grid coordinates fit the unsigned shorts of the instances
+    QSharedPointer<OMFReader> dataPtr;
+    float maxmag, minmag;
+    QColor spriteColor;
+    int slices; // Resolution for cones/vects
+    float vectorLength, vectorRadius, vectorTipLengthRatio, vectorShaftRadiusRatio;
+
+    // Lighting
+    GLfloat   lightAmbient;
+    QVector4D lightIntensity;
+    QVector4D lightPosition;
+    float brightness;
+
+    // View Related
+    QSize mandatedSize;
+    QColor backgroundColor;
+    QMatrix4x4 projection, view, model;
+    bool displayOn;
+    QVector3D com, location, maxExtent, minExtent;
+    float xcom, ycom, zcom;
+    float xmax, ymax, zmax;
+    float xmin, ymin, zmin;
+    int xRot, yRot, zRot;
+    float xLoc, yLoc, zLoc, zoom;
+    // slice variables
+    int xSliceLow, xSliceHigh;
+    int ySliceLow, ySliceHigh;
+    int zSliceLow, zSliceHigh;
+    int thresholdLow, thresholdHigh;
+
+    // Coloring
+    QString colorScale;
+    QString coloredQuantity;
+    QString vectorOrigin;
+    QString spriteScale;
+    QColor customSpriteColor(float val); // val goes from 0 to 1.0
+    QList<QColor> customColors;
+    QMap<QString, int> display_type_map;
+
+    // Thin film rendering: single layer vector data is drawn as one
+    // colour-mapped quad, with glyphs overlaid at a screen-space stride
+    bool isFilm();
+    int filmSubsampling();
+    bool filmMode;
+    bool filmDirty;  // Film texture is stale w.r.t. data
+    GLuint filmTexture;
+    int filmStep;    // Cells per texel along each axis
+
+    // Cube volumes: only the faces not hidden by a visible neighbour
+    // are drawn, as one mesh rebuilt when data, slices or thresholds change
+    bool useSurface();
+    bool surfaceMode;
+    bool greedyMode;   // Merge same-coloured faces of scalar data into larger quads
+    bool surfaceDirty; // Mesh is stale w.r.t. data, slices or thresholds
+    int surfaceIndices; // Zero when the instanced cubes are cheaper
+    QOpenGLBuffer surface_vbo;
+    QOpenGLBuffer surface_ibo;
+    QOpenGLVertexArrayObject *surfaceVao;
+    QList<surfaceCacheEntry> surfaceCache; // Most recently used first, builder thread only
+
+    // Scalar data ray-marched through a 3D texture
+    bool useVolume();
+    bool volumeMode;
+    bool volumeDirty; // Volume texture is stale w.r.t. data
+    GLuint volumeTexture;
+    QVector<int> volumeTexels; // Texels along x, y and z
+    int volumeStep;            // Cells per texel along each axis
+
+    // Streamlines of vector data, drawn as line strips over the glyphs
+    bool useFieldLines();
+    QString fieldLineSeeds; // "Off", "Grid" or "Slice Plane"
+    bool fieldLinesDirty;   // Lines are stale w.r.t. data or slices
+    QOpenGLBuffer fieldline_vbo;
+    QOpenGLVertexArrayObject *fieldLineVao;
+    QVector<GLint> fieldLineFirsts;
+    QVector<GLsizei> fieldLineCounts;
+    QList<fieldLineCacheEntry> fieldLineCache; // Most recently used first, builder thread only
+
+    // Lit isosurface of one component, or of scalar data, drawn over the glyphs
+    bool useIsosurface();
+    QString isoComponent; // "Off", "X", "Y" or "Z"
+    int isoValue;         // Slider position, 0 to 1600
+    bool isoDirty;        // Mesh is stale w.r.t. data, iso-value or slices
+    isoSampling isoSamples; // Builder thread only
+    QOpenGLBuffer iso_vbo;
+    QOpenGLBuffer iso_ibo;
+    QOpenGLVertexArrayObject *isoVao;
+    int isoIndices;
+    QList<isoCacheEntry> isoCache; // Most recently used first, builder thread only
+
+    // Render control
+    void scheduleFrame(); // Wake up for the next frame without a redraw
+    bool needsUpdate;
+    bool needsPush;   // Instance buffers are stale w.r.t. data or subsampling
+    QTimer *renderTimer;
+    QElapsedTimer lastFrame;
+    QElapsedTimer startupTimer; // From construction until the first frame
+    QString filename; // for rendering image sequences...
+
+    // Adaptive quality: while the view is changing, glyphs get coarser
+    // until frames fit the budget of the target frame rate
+    void drawScene();
+    void adaptQuality();
+    void setQualityDrop(int drop);
+    int lodBias();          // Extra steps towards coarser glyph meshes
+    int extraSubsampling(); // Extra subsampling levels on top of the user's
+    void initializeFrameQueries();
+    void beginFrameQuery();
+    void endFrameQuery();
+    int targetFrameRate;  // Zero turns the controller off
+    int qualityDrop;      // Steps below full quality
+    int qualityWait;      // Frames until the last step shows in the timings
+    bool interacting;
+    QTimer *settleTimer;  // Restores full quality once the view rests
+    QElapsedTimer frameTimer;
+    float cpuFrameTime, gpuFrameTime; // Milliseconds
+    GLuint frameQueries[3];           // GL_TIME_ELAPSED, read a few frames late
+    bool frameQueryIssued[3];
+    int frameQuery;
+
+    // Dynamic resolution: while the view is changing, the scene may be
+    // drawn to a smaller framebuffer and stretched over the widget
+    void setRenderScale(float scale);
+    bool bindSceneFramebuffer();
+    void drawUpscaled();
+    float renderScale;    // Fraction of the widget resolution, 1 draws directly
+    float minRenderScale, maxRenderScale;
+    int viewportWidth, viewportHeight;
+    QOpenGLFramebufferObject *sceneFbo;
+    QOpenGLVertexArrayObject *upscaleVao; // Empty, the triangle comes from gl_VertexID
+
+    // Images are drawn into a framebuffer of their own, see renderImage
+    bool makeContextCurrent();
+
+    // Instances are built off the rendering thread. Large lattices come back
+    // coarse first, and at the requested level a little later.
+    instanceBuilder *builder;
+    int pushedGeneration; // Of the latest request to the builder
+    bool progressive;     // Off while exporting images
+    bool refining;        // Requested level not shown yet
+    int refineLevel;
+    int pushedAssets[assetKinds]; // Generation of the latest job of each kind
+    int shownAssets[assetKinds];  // And of the one drawn
+    // Lattice of the final frame on screen, none while a preview is
+    bool finalShown;
+    int finalLevel;
+    QVector<int> finalShape;
+    QVector3D finalSliceLow, finalSliceHigh;
+
+};
+
+#endif // GLRENDERER_H
+
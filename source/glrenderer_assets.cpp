@@ -0,0 +1,774 @@
+#include <QtGui>
+#include <QDebug>
+#include "glrenderer.h"
+#include <cstddef>
+#include <string.h>
+#include <vector>
+#include <math.h>
+
+// Append a vertex (position, normal) and return its index
+static GLuint addVertex(std::vector<GLfloat> &vertices,
+                        float x, float y, float z, float nx, float ny, float nz)
+{
+    GLuint index = vertices.size()/6;
+    vertices.push_back(x);
+    vertices.push_back(y);
+    vertices.push_back(z);
+    vertices.push_back(nx);
+    vertices.push_back(ny);
+    vertices.push_back(nz);
+    return index;
+}
+
+static void addTriangle(std::vector<GLuint> &indices, GLuint a, GLuint b, GLuint c)
+{
+    indices.push_back(a);
+    indices.push_back(b);
+    indices.push_back(c);
+}
+
+// Score of a vertex for the cache optimizer below
+static float vertexCacheScore(int cachePosition, int remainingValence, int cacheSize)
+{
+    if (remainingValence == 0) {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // Used by the last triangle, don't reward re-use too strongly
+            score = 0.75f;
+        } else {
+            score = pow(1.0f - (float)(cachePosition - 3)/(float)(cacheSize - 3), 1.5f);
+        }
+    }
+    // Favour finishing off vertices with few triangles left
+    score += 2.0f/sqrt((float)remainingValence);
+    return score;
+}
+
+// Reorder triangles for the post-transform vertex cache, following
+// Tom Forsyth's "Linear-Speed Vertex Cache Optimisation". The glyph
+// meshes are small, so the simple quadratic fallback search is fine.
+static void optimizeVertexCache(std::vector<GLuint> &indices, GLuint numVertices)
+{
+    const int cacheSize = 32;
+    const int numTris = indices.size()/3;
+
+    std::vector<int> remaining(numVertices, 0);
+    std::vector<int> cachePos(numVertices, -1);
+    std::vector<std::vector<int> > vertexTris(numVertices);
+    for (int t=0; t<numTris; t++) {
+        for (int c=0; c<3; c++) {
+            remaining[indices[3*t+c]]++;
+            vertexTris[indices[3*t+c]].push_back(t);
+        }
+    }
+
+    std::vector<bool> emitted(numTris, false);
+    std::vector<GLuint> cache;
+    std::vector<GLuint> output;
+    output.reserve(indices.size());
+
+    for (int n=0; n<numTris; n++) {
+        // Best candidate among triangles touching the cache...
+        int best = -1;
+        float bestScore = -1.0f;
+        for (size_t c=0; c<cache.size(); c++) {
+            const std::vector<int> &tris = vertexTris[cache[c]];
+            for (size_t i=0; i<tris.size(); i++) {
+                int t = tris[i];
+                if (emitted[t]) continue;
+                float score = 0.0f;
+                for (int k=0; k<3; k++) {
+                    GLuint v = indices[3*t+k];
+                    score += vertexCacheScore(cachePos[v], remaining[v], cacheSize);
+                }
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+        // ...otherwise the first triangle not yet emitted
+        if (best < 0) {
+            for (int t=0; t<numTris; t++) {
+                if (!emitted[t]) {
+                    best = t;
+                    break;
+                }
+            }
+        }
+
+        emitted[best] = true;
+        std::vector<GLuint> newCache;
+        for (int k=0; k<3; k++) {
+            GLuint v = indices[3*best+k];
+            output.push_back(v);
+            remaining[v]--;
+            newCache.push_back(v);
+        }
+        for (size_t c=0; c<cache.size(); c++) {
+            GLuint v = cache[c];
+            if (v != newCache[0] && v != newCache[1] && v != newCache[2]) {
+                newCache.push_back(v);
+            }
+        }
+        for (size_t c=0; c<newCache.size(); c++) {
+            cachePos[newCache[c]] = ((int)c < cacheSize) ? (int)c : -1;
+        }
+        if (newCache.size() > (size_t)cacheSize) {
+            newCache.resize(cacheSize);
+        }
+        cache = newCache;
+    }
+
+    indices = output;
+}
+
+// Optimize a freshly built mesh and append it to the sprite's
+// buffers, returning where its indices ended up
+static spriteLOD appendLOD(std::vector<GLfloat> &vertices, std::vector<GLuint> &indices,
+                           const std::vector<GLfloat> &meshVertices, std::vector<GLuint> &meshIndices)
+{
+    GLuint baseVertex = vertices.size()/6;
+    optimizeVertexCache(meshIndices, meshVertices.size()/6);
+
+    spriteLOD lod;
+    lod.offset = indices.size();
+    lod.count  = meshIndices.size();
+    for (size_t i=0; i<meshIndices.size(); i++) {
+        indices.push_back(baseVertex + meshIndices[i]);
+    }
+    vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+    return lod;
+}
+
+// Tessellations used for the levels of detail, finest first
+static QVector<int> lodSlices(int slices)
+{
+    QVector<int> levels;
+    levels << slices;
+    while (levels.size() < 3 && levels.last() > 4) {
+        levels << qMax(4, levels.last()/2);
+    }
+    return levels;
+}
+
+void GLRenderer::initializeAssets()
+{
+    // Prepare a complete shader program...
+    initializeShaders();
+    initializeInstanceBuffers();
+    initializeCube();
+    initializeFilm();
+    initializeSurface();
+    initializeVolume();
+    initializeFieldLines();
+    initializeIsosurface();
+    initializeLights();
+}
+
+void GLRenderer::buildGlyph(sprite *object)
+{
+    // Glyph meshes other than the cube are only built once their display
+    // type is used, and rebuilt when the glyph dimensions change
+    if (!object->stale) {
+        return;
+    }
+    object->stale = false;
+    if (object == &cone) {
+        initializeCone(slices, 1.0*vectorRadius, 2.0*vectorLength);
+    } else if (object == &vect) {
+        initializeVect(slices, 5.0f*vectorLength, 1.0f*vectorRadius, vectorTipLengthRatio, vectorShaftRadiusRatio);
+    } else if (object == &impostor) {
+        initializeImpostor();
+    } else if (object == &lines) {
+        initializeLines(5.0f*vectorLength);
+    } else if (object == &points) {
+        initializePoints();
+    }
+}
+
+bool GLRenderer::initializeLights()
+{
+    lightIntensity = QVector4D(1.0,1.0,1.0,1.0);
+    lightPosition = QVector4D(10,10,150,1.0);
+    lightAmbient = 0.4f;
+    return true;
+}
+
+bool GLRenderer::initializeShaders()
+{
+    // Linked programs are cached on disk by Qt, keyed by the sources and
+    // the driver, and compiled from source whenever the cache misses
+    bool result = true;
+
+    result = result && cubeShader.addCacheableShaderFromSourceFile( QOpenGLShader::Vertex,   ":/shaders/cube.vert" );
+    result = result && cubeShader.addCacheableShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/cube.frag" );
+
+    result = result && standardShader.addCacheableShaderFromSourceFile( QOpenGLShader::Vertex,   ":/shaders/standard.vert" );
+    result = result && standardShader.addCacheableShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/standard.frag"  );
+
+    result = result && flatShader.addCacheableShaderFromSourceFile( QOpenGLShader::Vertex,   ":/shaders/standard.vert" );
+    result = result && flatShader.addCacheableShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/flat.frag" );
+
+    result = result && filmShader.addCacheableShaderFromSourceFile( QOpenGLShader::Vertex,   ":/shaders/film.vert" );
+    result = result && filmShader.addCacheableShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/film.frag" );
+
+    result = result && volumeShader.addCacheableShaderFromSourceFile( QOpenGLShader::Vertex,   ":/shaders/volume.vert" );
+    result = result && volumeShader.addCacheableShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/volume.frag" );
+
+    result = result && fieldLineShader.addCacheableShaderFromSourceFile( QOpenGLShader::Vertex,   ":/shaders/fieldline.vert" );
+    result = result && fieldLineShader.addCacheableShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/flat.frag" );
+
+    result = result && isoShader.addCacheableShaderFromSourceFile( QOpenGLShader::Vertex,   ":/shaders/iso.vert" );
+    result = result && isoShader.addCacheableShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/iso.frag" );
+
+    result = result && impostorShader.addCacheableShaderFromSourceFile( QOpenGLShader::Vertex,   ":/shaders/impostor.vert" );
+    result = result && impostorShader.addCacheableShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/impostor.frag" );
+
+    result = result && upscaleShader.addCacheableShaderFromSourceFile( QOpenGLShader::Vertex,   ":/shaders/upscale.vert" );
+    result = result && upscaleShader.addCacheableShaderFromSourceFile( QOpenGLShader::Fragment, ":/shaders/upscale.frag" );
+
+    if ( !result ) {
+        qWarning() << "Shaders could not be loaded (flat)"    << cubeShader.log();
+        qWarning() << "Shaders could not be loaded (diffuse)" << standardShader.log();
+        qWarning() << "Shaders could not be loaded (unlit)"   << flatShader.log();
+        qWarning() << "Shaders could not be loaded (impostor)" << impostorShader.log();
+        qWarning() << "Shaders could not be loaded (film)"     << filmShader.log();
+        qWarning() << "Shaders could not be loaded (volume)"   << volumeShader.log();
+        qWarning() << "Shaders could not be loaded (field lines)" << fieldLineShader.log();
+        qWarning() << "Shaders could not be loaded (isosurface)"  << isoShader.log();
+        qWarning() << "Shaders could not be loaded (upscale)"     << upscaleShader.log();
+    }
+    return result;
+}
+
+bool GLRenderer::initializeInstanceBuffers()
+{
+    // Stand-ins the sprite VAOs are set up with, until the first frame
+    // comes in buffers of the instance builder, see adoptInstances
+    QOpenGLBuffer pos_vbo(QOpenGLBuffer::VertexBuffer);
+    QOpenGLBuffer mag_vbo(QOpenGLBuffer::VertexBuffer);
+    pos_vbo.create();
+    mag_vbo.create();
+    pos_vbo.setUsagePattern( QOpenGLBuffer::DynamicDraw );
+    mag_vbo.setUsagePattern( QOpenGLBuffer::DynamicDraw );
+
+    if ( !pos_vbo.bind() )
+    {
+        qWarning() << "Could not bind position buffer to the context";
+        return false;
+    }
+    pos_vbo.allocate( 1 * sizeof(instancePosition) );
+    pos_vbo.release();
+
+    if ( !mag_vbo.bind() )
+    {
+        qWarning() << "Could not bind magnetization buffer to the context";
+        return false;
+    }
+    mag_vbo.allocate( 1 * sizeof(instanceVector) );
+    mag_vbo.release();
+
+    pos_vbos << pos_vbo;
+    mag_vbos << mag_vbo;
+    return true;
+}
+
+bool GLRenderer::initializeInstanceAttributes()
+{
+    // Must be called with a sprite's VAO bound. Attribute locations
+    // are fixed by the layout qualifiers in the vertex shaders.
+    if ( pos_vbos.isEmpty() || !pos_vbos.first().isCreated() || !mag_vbos.first().isCreated() )
+    {
+        qWarning() << "Instance buffers have not been created";
+        return false;
+    }
+    gl330Funcs->glEnableVertexAttribArray(3); // "translation" vbo
+    gl330Funcs->glVertexAttribDivisor(3, 1);
+    gl330Funcs->glEnableVertexAttribArray(2); // "magnetization" vbo, snorm16
+    gl330Funcs->glVertexAttribDivisor(2, 1);
+    setInstanceOffset(0);
+    return true;
+}
+
+GLsizei GLRenderer::setInstanceOffset(qint64 first)
+{
+    // There is no base instance in GL 3.3, so draws over a range of
+    // instances point the attributes at the range instead. Returns
+    // how many instances from there on lie in the same buffer.
+    int segment  = (int)qMin(first/instancesPerBuffer, (qint64)pos_vbos.size() - 1);
+    qint64 local = first - segment*instancesPerBuffer;
+    pos_vbos[segment].bind();
+    gl330Funcs->glVertexAttribPointer(3, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(instancePosition),
+                                      reinterpret_cast<const void *>(local * sizeof(instancePosition)));
+    mag_vbos[segment].bind();
+    gl330Funcs->glVertexAttribPointer(2, 3, GL_SHORT, GL_TRUE, sizeof(instanceVector),
+                                      reinterpret_cast<const void *>(local * sizeof(instanceVector)));
+    mag_vbos[segment].release();
+    return (GLsizei)(instancesPerBuffer - local);
+}
+
+bool GLRenderer::initializeSprite(sprite &object, QOpenGLShaderProgram &shader,
+                                const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices,
+                                const QVector<spriteLOD> &lods, float extent, GLenum mode)
+{
+    if (!object.vbo.isCreated()) {
+        object.vbo = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+        object.ibo = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+        object.vbo.create();
+        object.ibo.create();
+
+        object.vao = new QOpenGLVertexArrayObject(this);
+        object.vao->create();
+    } else {
+        object.vbo.destroy();
+        object.ibo.destroy();
+        object.vbo.create();
+        object.ibo.create();
+        object.vao->destroy();
+        object.vao->create();
+    }
+
+    object.vao->bind();
+    object.lods   = lods;
+    object.extent = extent;
+    object.mode   = mode;
+
+    // Bind the shader program so that we can associate variables from
+    // our application to the shaders
+    if ( !shader.bind() )
+    {
+        qWarning() << "Could not bind shader program to context" << shader.log();
+        return false;
+    }
+
+    // Set usage. Vertices are static, instance data lives in the shared buffers
+    object.vbo.setUsagePattern( QOpenGLBuffer::StaticDraw );
+    object.ibo.setUsagePattern( QOpenGLBuffer::StaticDraw );
+
+    if ( !object.vbo.bind() )
+    {
+        qWarning() << "Could not bind vertex buffer to the context";
+        return false;
+    }
+    object.vbo.allocate( &vertices.front(), vertices.size() * sizeof(vertices[0]) );
+    shader.setAttributeBuffer( "vertex", GL_FLOAT, 0, 3, 6*sizeof(GLfloat) );
+    shader.enableAttributeArray( "vertex" );
+    shader.setAttributeBuffer( "vertexNormal", GL_FLOAT, 3*sizeof(GLfloat), 3, 6*sizeof(GLfloat) );
+    shader.enableAttributeArray( "vertexNormal" );
+    object.vbo.release();
+
+    // The element buffer binding is part of the VAO state, so leave it bound
+    if ( !object.ibo.bind() )
+    {
+        qWarning() << "Could not bind index buffer to the context";
+        return false;
+    }
+    object.ibo.allocate( &indices.front(), indices.size() * sizeof(indices[0]) );
+
+    if ( !initializeInstanceAttributes() )
+    {
+        return false;
+    }
+
+    object.vao->release();
+    shader.release();
+    return true;
+}
+
+bool GLRenderer::initializeCube()
+{
+    // Each face has its own four corners so that the normals stay flat.
+    // Normal, then the two in-plane directions with u x v = n.
+    static const float faces[6][9] = {
+        { 1.0f, 0.0f, 0.0f,    0.0f, 1.0f, 0.0f,    0.0f, 0.0f, 1.0f},
+        {-1.0f, 0.0f, 0.0f,    0.0f, 0.0f, 1.0f,    0.0f, 1.0f, 0.0f},
+        { 0.0f, 1.0f, 0.0f,    0.0f, 0.0f, 1.0f,    1.0f, 0.0f, 0.0f},
+        { 0.0f,-1.0f, 0.0f,    1.0f, 0.0f, 0.0f,    0.0f, 0.0f, 1.0f},
+        { 0.0f, 0.0f, 1.0f,    1.0f, 0.0f, 0.0f,    0.0f, 1.0f, 0.0f},
+        { 0.0f, 0.0f,-1.0f,    0.0f, 1.0f, 0.0f,    1.0f, 0.0f, 0.0f}
+    };
+    static const float corners[4][2] = { {-1.0f,-1.0f}, {1.0f,-1.0f}, {1.0f,1.0f}, {-1.0f,1.0f} };
+
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    for (int f = 0; f<6; f++) {
+        const float *n = faces[f];
+        const float *u = faces[f] + 3;
+        const float *v = faces[f] + 6;
+        GLuint first = vertices.size()/6;
+        for (int c = 0; c<4; c++) {
+            addVertex(vertices,
+                      n[0] + corners[c][0]*u[0] + corners[c][1]*v[0],
+                      n[1] + corners[c][0]*u[1] + corners[c][1]*v[1],
+                      n[2] + corners[c][0]*u[2] + corners[c][1]*v[2],
+                      n[0], n[1], n[2]);
+        }
+        // Counter-clockwise when seen from outside
+        addTriangle(indices, first, first+1, first+2);
+        addTriangle(indices, first, first+2, first+3);
+    }
+
+    std::vector<GLfloat> allVertices;
+    std::vector<GLuint> allIndices;
+    QVector<spriteLOD> lods;
+    lods << appendLOD(allVertices, allIndices, vertices, indices);
+
+    return initializeSprite(cube, cubeShader, allVertices, allIndices, lods, 2.0f, GL_TRIANGLES);
+}
+
+bool GLRenderer::initializeIsosurface()
+{
+    // Filled by the isosurface jobs, see pushIsosurface
+    iso_vbo = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    iso_ibo = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+    iso_vbo.create();
+    iso_ibo.create();
+    iso_vbo.setUsagePattern( QOpenGLBuffer::DynamicDraw );
+    iso_ibo.setUsagePattern( QOpenGLBuffer::DynamicDraw );
+
+    isoVao = new QOpenGLVertexArrayObject(this);
+    if ( !isoVao->create() )
+    {
+        qWarning() << "Could not create the isosurface vertex array object";
+        delete isoVao;
+        isoVao = 0;
+        return false;
+    }
+    bindIsoBuffers();
+
+    isoDirty = true;
+    return true;
+}
+
+void GLRenderer::bindIsoBuffers()
+{
+    // Again whenever a new mesh comes in buffers of its own
+    isoVao->bind();
+    iso_vbo.bind();
+    gl330Funcs->glEnableVertexAttribArray(0); // "vertex"
+    gl330Funcs->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(isoVertex),
+                                      reinterpret_cast<const void *>(offsetof(isoVertex, x)));
+    gl330Funcs->glEnableVertexAttribArray(1); // "vertexNormal"
+    gl330Funcs->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(isoVertex),
+                                      reinterpret_cast<const void *>(offsetof(isoVertex, nx)));
+    gl330Funcs->glEnableVertexAttribArray(2); // "magnetization", snorm16
+    gl330Funcs->glVertexAttribPointer(2, 3, GL_SHORT, GL_TRUE, sizeof(isoVertex),
+                                      reinterpret_cast<const void *>(offsetof(isoVertex, magnetization)));
+    iso_ibo.bind();
+    isoVao->release();
+    iso_vbo.release();
+}
+
+bool GLRenderer::initializeFieldLines()
+{
+    // Filled by the field line jobs, see pushFieldLines
+    fieldline_vbo = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    fieldline_vbo.create();
+    fieldline_vbo.setUsagePattern( QOpenGLBuffer::DynamicDraw );
+
+    fieldLineVao = new QOpenGLVertexArrayObject(this);
+    if ( !fieldLineVao->create() )
+    {
+        qWarning() << "Could not create the field line vertex array object";
+        delete fieldLineVao;
+        fieldLineVao = 0;
+        return false;
+    }
+    bindFieldLineBuffers();
+
+    fieldLinesDirty = true;
+    return true;
+}
+
+void GLRenderer::bindFieldLineBuffers()
+{
+    // Again whenever new lines come in a buffer of their own
+    fieldLineVao->bind();
+    fieldline_vbo.bind();
+    gl330Funcs->glEnableVertexAttribArray(0); // "vertex"
+    gl330Funcs->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(fieldLineVertex),
+                                      reinterpret_cast<const void *>(offsetof(fieldLineVertex, x)));
+    gl330Funcs->glEnableVertexAttribArray(2); // "magnetization", snorm16
+    gl330Funcs->glVertexAttribPointer(2, 3, GL_SHORT, GL_TRUE, sizeof(fieldLineVertex),
+                                      reinterpret_cast<const void *>(offsetof(fieldLineVertex, magnetization)));
+    fieldLineVao->release();
+    fieldline_vbo.release();
+}
+
+bool GLRenderer::initializeVolume()
+{
+    // Replaced by the volume jobs, see pushVolume, interpolated between cell centres
+    glGenTextures(1, &volumeTexture);
+    glBindTexture(GL_TEXTURE_3D, volumeTexture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    volumeDirty = true;
+    return true;
+}
+
+bool GLRenderer::initializeSurface()
+{
+    // Filled by the surface jobs, see pushSurface. All attributes are per vertex.
+    surface_vbo = QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    surface_ibo = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+    surface_vbo.create();
+    surface_ibo.create();
+    surface_vbo.setUsagePattern( QOpenGLBuffer::DynamicDraw );
+    surface_ibo.setUsagePattern( QOpenGLBuffer::DynamicDraw );
+
+    surfaceVao = new QOpenGLVertexArrayObject(this);
+    if ( !surfaceVao->create() )
+    {
+        qWarning() << "Could not create the surface vertex array object";
+        delete surfaceVao;
+        surfaceVao = 0;
+        return false;
+    }
+    bindSurfaceBuffers();
+
+    surfaceDirty = true;
+    return true;
+}
+
+void GLRenderer::bindSurfaceBuffers()
+{
+    // Again whenever a new mesh comes in buffers of its own
+    surfaceVao->bind();
+    surface_vbo.bind();
+    gl330Funcs->glEnableVertexAttribArray(0); // "vertex"
+    gl330Funcs->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(surfaceVertex),
+                                      reinterpret_cast<const void *>(offsetof(surfaceVertex, x)));
+    gl330Funcs->glEnableVertexAttribArray(1); // "vertexNormal"
+    gl330Funcs->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(surfaceVertex),
+                                      reinterpret_cast<const void *>(offsetof(surfaceVertex, nx)));
+    gl330Funcs->glEnableVertexAttribArray(2); // "magnetization", snorm16
+    gl330Funcs->glVertexAttribPointer(2, 3, GL_SHORT, GL_TRUE, sizeof(surfaceVertex),
+                                      reinterpret_cast<const void *>(offsetof(surfaceVertex, magnetization)));
+    gl330Funcs->glEnableVertexAttribArray(3); // "translation"
+    gl330Funcs->glVertexAttribPointer(3, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(surfaceVertex),
+                                      reinterpret_cast<const void *>(offsetof(surfaceVertex, translation)));
+    surface_ibo.bind();
+    surfaceVao->release();
+    surface_vbo.release();
+}
+
+bool GLRenderer::initializeImpostor()
+{
+    // A single quad, expanded around each glyph in the vertex shader.
+    // The glyph itself is ray-cast in the fragment shader.
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    addVertex(vertices, -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    addVertex(vertices,  1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    addVertex(vertices,  1.0f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    addVertex(vertices, -1.0f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    addTriangle(indices, 0, 1, 2);
+    addTriangle(indices, 0, 2, 3);
+
+    std::vector<GLfloat> allVertices;
+    std::vector<GLuint> allIndices;
+    QVector<spriteLOD> lods;
+    lods << appendLOD(allVertices, allIndices, vertices, indices);
+
+    return initializeSprite(impostor, impostorShader, allVertices, allIndices, lods, 2.0f, GL_TRIANGLES);
+}
+
+bool GLRenderer::initializePoints()
+{
+    // One vertex per cell, drawn as a point
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    indices.push_back(addVertex(vertices, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f));
+
+    QVector<spriteLOD> lods;
+    spriteLOD lod = { 0, 1 };
+    lods << lod;
+
+    return initializeSprite(points, flatShader, vertices, indices, lods, 2.0f, GL_POINTS);
+}
+
+bool GLRenderer::initializeLines(float height)
+{
+    // Two vertices per cell: a segment along the vector, placed
+    // according to the same origin preference as the arrows
+    float tailOffset = (vectorOrigin == "Tail") ? 0.0f : -height/2.0f;
+
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    indices.push_back(addVertex(vertices, 0.0f, 0.0f, tailOffset,        0.0f, 0.0f, 1.0f));
+    indices.push_back(addVertex(vertices, 0.0f, 0.0f, tailOffset+height, 0.0f, 0.0f, 1.0f));
+
+    QVector<spriteLOD> lods;
+    spriteLOD lod = { 0, 2 };
+    lods << lod;
+
+    return initializeSprite(lines, flatShader, vertices, indices, lods, height, GL_LINES);
+}
+
+bool GLRenderer::initializeFilm()
+{
+    // Nearest filtering keeps individual cells crisp when zoomed in
+    glGenTextures(1, &filmTexture);
+    glBindTexture(GL_TEXTURE_2D, filmTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Unit square, stretched over the layer in film.vert
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    addVertex(vertices, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    addVertex(vertices, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    addVertex(vertices, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    addVertex(vertices, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    addTriangle(indices, 0, 1, 2);
+    addTriangle(indices, 0, 2, 3);
+
+    QVector<spriteLOD> lods;
+    spriteLOD lod = { 0, 6 };
+    lods << lod;
+
+    return initializeSprite(film, filmShader, vertices, indices, lods, 2.0f, GL_TRIANGLES);
+}
+
+static void buildConeMesh(std::vector<GLfloat> &vertices, std::vector<GLuint> &indices,
+                          int slices, float radius, float height)
+{
+    float normScale = 1.0/sqrt(height*height + radius*radius);
+
+    // Top (Pointy part). The ring is shared between neighbouring slices,
+    // the apex is not since its normal points along the slice centre.
+    GLuint ring = vertices.size()/6;
+    for (int i = 0; i<slices; i++) {
+        addVertex(vertices,  radius*cos(2.0*PI*i/slices), -radius*sin(2.0*PI*i/slices), 0.0f,
+                  normScale*height*cos(2.0*PI*i/slices), -normScale*height*sin(2.0*PI*i/slices), radius*normScale);
+    }
+    for (int i = 0; i<slices; i++) {
+        GLuint apex = addVertex(vertices, 0.0f, 0.0f, height,
+                                normScale*height*cos(2.0*PI*(i+0.5)/slices), -normScale*height*sin(2.0*PI*(i+0.5)/slices), radius*normScale);
+        addTriangle(indices, apex, ring + (i+1)%slices, ring + i);
+    }
+
+    // Bottom
+    GLuint center = addVertex(vertices, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f);
+    GLuint base   = vertices.size()/6;
+    for (int i = 0; i<slices; i++) {
+        addVertex(vertices, radius*cos(2.0*PI*i/slices), -radius*sin(2.0*PI*i/slices), 0.0f, 0.0f, 0.0f, -1.0f);
+    }
+    for (int i = 0; i<slices; i++) {
+        addTriangle(indices, center, base + (i+slices-1)%slices, base + i);
+    }
+}
+
+bool GLRenderer::initializeCone(int slices, float radius, float height)
+{
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    QVector<spriteLOD> lods;
+
+    QVector<int> levels = lodSlices(slices);
+    for (int l=0; l<levels.size(); l++) {
+        std::vector<GLfloat> meshVertices;
+        std::vector<GLuint> meshIndices;
+        buildConeMesh(meshVertices, meshIndices, levels[l], radius, height);
+        lods << appendLOD(vertices, indices, meshVertices, meshIndices);
+    }
+
+    return initializeSprite(cone, standardShader, vertices, indices, lods, qMax(2.0f*radius, height), GL_TRIANGLES);
+}
+
+static void buildVectMesh(std::vector<GLfloat> &vertices, std::vector<GLuint> &indices,
+                          int slices, float height, float radius, float fractionTip, float fractionInner,
+                          float headOffset, float tailOffset)
+{
+    float normScale = 1.0/sqrt(height*height + radius*radius);
+    float centerOffset = tailOffset + height*(1.0f-fractionTip);
+    float tipHeight = height*fractionTip;
+    float innerRadius = radius*fractionInner;
+
+    // Top (Pointy part)
+    GLuint ring = vertices.size()/6;
+    for (int i = 0; i<slices; i++) {
+        addVertex(vertices, radius*cos(2.0*PI*i/slices), -radius*sin(2.0*PI*i/slices), centerOffset,
+                  normScale*tipHeight*cos(2.0*PI*i/slices), -normScale*tipHeight*sin(2.0*PI*i/slices), radius*normScale);
+    }
+    for (int i = 0; i<slices; i++) {
+        GLuint apex = addVertex(vertices, 0.0f, 0.0f, headOffset,
+                                normScale*tipHeight*cos(2.0*PI*(i+0.5)/slices), -normScale*tipHeight*sin(2.0*PI*(i+0.5)/slices), radius*normScale);
+        addTriangle(indices, apex, ring + (i+1)%slices, ring + i);
+    }
+
+    // Bottom (Pointy part)
+    GLuint center = addVertex(vertices, 0.0f, 0.0f, centerOffset, 0.0f, 0.0f, -1.0f);
+    GLuint base   = vertices.size()/6;
+    for (int i = 0; i<slices; i++) {
+        addVertex(vertices, radius*cos(2.0*PI*i/slices), -radius*sin(2.0*PI*i/slices), centerOffset, 0.0f, 0.0f, -1.0f);
+    }
+    for (int i = 0; i<slices; i++) {
+        addTriangle(indices, center, base + (i+slices-1)%slices, base + i);
+    }
+
+    // Bottom (tail)
+    GLuint tailCenter = addVertex(vertices, 0.0f, 0.0f, tailOffset, 0.0f, 0.0f, -1.0f);
+    GLuint tailBase   = vertices.size()/6;
+    for (int i = 0; i<slices; i++) {
+        addVertex(vertices, innerRadius*cos(2.0*PI*i/slices), -innerRadius*sin(2.0*PI*i/slices), tailOffset, 0.0f, 0.0f, -1.0f);
+    }
+    for (int i = 0; i<slices; i++) {
+        addTriangle(indices, tailCenter, tailBase + (i+slices-1)%slices, tailBase + i);
+    }
+
+    // Sides (tail)
+    GLuint shaftLow = vertices.size()/6;
+    for (int i = 0; i<slices; i++) {
+        addVertex(vertices, innerRadius*cos(2.0*PI*i/slices), -innerRadius*sin(2.0*PI*i/slices), tailOffset,
+                  cos(2.0*PI*i/slices), -sin(2.0*PI*i/slices), 0.0f);
+    }
+    GLuint shaftHigh = vertices.size()/6;
+    for (int i = 0; i<slices; i++) {
+        addVertex(vertices, innerRadius*cos(2.0*PI*i/slices), -innerRadius*sin(2.0*PI*i/slices), centerOffset,
+                  cos(2.0*PI*i/slices), -sin(2.0*PI*i/slices), 0.0f);
+    }
+    for (int i = 0; i<slices; i++) {
+        int prev = (i+slices-1)%slices;
+        addTriangle(indices, shaftLow + i,    shaftLow + prev,  shaftHigh + i);
+        addTriangle(indices, shaftLow + prev, shaftHigh + prev, shaftHigh + i);
+    }
+}
+
+bool GLRenderer::initializeVect(int slices, float height, float radius, float fractionTip, float fractionInner)
+{
+    float headOffset, tailOffset;
+    if (vectorOrigin == "Tail") {
+        tailOffset = 0.0f;
+        headOffset = height;
+    } else { // Center origin
+        tailOffset = -height/2.0f;
+        headOffset =  height/2.0f;
+    }
+
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    QVector<spriteLOD> lods;
+
+    QVector<int> levels = lodSlices(slices);
+    for (int l=0; l<levels.size(); l++) {
+        std::vector<GLfloat> meshVertices;
+        std::vector<GLuint> meshIndices;
+        buildVectMesh(meshVertices, meshIndices, levels[l], height, radius, fractionTip, fractionInner,
+                      headOffset, tailOffset);
+        lods << appendLOD(vertices, indices, meshVertices, meshIndices);
+    }
+
+    return initializeSprite(vect, standardShader, vertices, indices, lods, qMax(2.0f*radius, height), GL_TRIANGLES);
+}
@@ -0,0 +1,221 @@
+#include <QtGui>
+#include "glrenderer.h"
+
+void GLRenderer::updateCOM()
+{
+    QVector<int> size = dataPtr->field->shape();
+    xcom = (float)size[0]*0.5;
+    ycom = (float)size[1]*0.5;
+    zcom = (float)size[2]*0.5;
+}
+
+void GLRenderer::rotateBy(int dx, int dy, int dz)
+{
+    if (dx) {
+        setXRotation(xRot + dx);
+    }
+    if (dy) {
+        setYRotation(yRot + dy);
+    }
+    if (dz) {
+        setZRotation(zRot + dz);
+    }
+}
+
+void GLRenderer::moveBy(float dx, float dy)
+{
+    setXLoc(xLoc + dx);
+    setYLoc(yLoc + dy);
+}
+
+void GLRenderer::zoomBy(float delta)
+{
+    zoom += delta;
+    beginInteraction();
+    requestRender();
+}
+
+void GLRenderer::sliceChanged()
+{
+    // Meshes clipped to the slice box
+    surfaceDirty = true;
+    fieldLinesDirty = true;
+    isoDirty = true;
+    requestRender();
+}
+
+void GLRenderer::setXSliceLow(int low)
+{
+    if (xSliceLow != low) {
+        xSliceLow = low;
+        sliceChanged();
+    }
+}
+
+void GLRenderer::setXSliceHigh(int high)
+{
+    if (xSliceHigh != high) {
+        xSliceHigh = high;
+        sliceChanged();
+    }
+}
+
+void GLRenderer::setYSliceLow(int low)
+{
+    if (ySliceLow != low) {
+        ySliceLow = low;
+        sliceChanged();
+    }
+}
+
+void GLRenderer::setYSliceHigh(int high)
+{
+    if (ySliceHigh != high) {
+        ySliceHigh = high;
+        sliceChanged();
+    }
+}
+
+void GLRenderer::setZSliceLow(int low)
+{
+    if (zSliceLow != low) {
+        zSliceLow = low;
+        sliceChanged();
+    }
+}
+
+void GLRenderer::setZSliceHigh(int high)
+{
+    if (zSliceHigh != high) {
+        zSliceHigh = high;
+        sliceChanged();
+    }
+}
+
+void GLRenderer::setThresholdLow(int low)
+{
+    if (thresholdLow != low) {
+        thresholdLow = low;
+        // Only the surface hides cells outside the thresholds
+        surfaceDirty = true;
+        requestRender();
+    }
+}
+
+void GLRenderer::setThresholdHigh(int high)
+{
+    if (thresholdHigh != high) {
+        thresholdHigh = high;
+        // Only the surface hides cells outside the thresholds
+        surfaceDirty = true;
+        requestRender();
+    }
+}
+
+static void qNormalizeAngle(int &angle)
+{
+  while (angle < 0)
+    angle += 360 * 1600;
+  while (angle > 360 * 1600)
+    angle -= 360 * 1600;
+}
+
+void GLRenderer::setXRotation(int angle)
+{
+  qNormalizeAngle(angle);
+  if (angle != xRot) {
+    xRot = angle;
+    emit xRotationChanged(angle);
+    requestRender();
+  }
+}
+
+void GLRenderer::setYRotation(int angle)
+{
+  qNormalizeAngle(angle);
+  if (angle != yRot) {
+    yRot = angle;
+    emit yRotationChanged(angle);
+    requestRender();
+  }
+}
+
+void GLRenderer::setZRotation(int angle)
+{
+  qNormalizeAngle(angle);
+  if (angle != zRot) {
+    zRot = angle;
+    emit zRotationChanged(angle);
+    requestRender();
+  }
+}
+
+void GLRenderer::setXLoc(float val)
+{
+  if (xLoc != val) {
+    xLoc = val;
+    emit COMChanged(val);
+    requestRender();
+  }
+}
+
+void GLRenderer::setYLoc(float val)
+{
+  if (yLoc != val) {
+    yLoc = val;
+    emit COMChanged(val);
+    requestRender();
+  }
+}
+
+void GLRenderer::setZLoc(float val)
+{
+  if (zLoc != val) {
+    zLoc = val;
+    emit COMChanged(val);
+    requestRender();
+  }
+}
+
+void GLRenderer::increaseSubsampling()
+{
+    subsampling++;
+    needsPush = true;
+    requestRender();
+}
+
+void GLRenderer::decreaseSubsampling()
+{
+    if (subsampling > 0) {
+        subsampling--;
+        needsPush = true;
+        requestRender();
+    }
+}
+
+void GLRenderer::setXCom(float val)
+{
+  if (xcom != val) {
+    xcom = val;
+    emit COMChanged(val);
+    requestRender();
+  }
+}
+
+void GLRenderer::setYCom(float val)
+{
+  if (ycom != val) {
+    ycom = val;
+    emit COMChanged(val);
+    requestRender();
+  }
+}
+
+void GLRenderer::setZCom(float val)
+{
+  if (zcom != val) {
+    zcom = val;
+    emit COMChanged(val);
+    requestRender();
+  }
+}
@@ -0,0 +1,69 @@
+#include <QDebug>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include "glrenderer.h"
+
+// Samples per pixel of rendered images, as for the multisampled window
+static const int imageSamples = 4;
+
+QImage GLRenderer::renderImage(QSize size)
+{
+    // Drawn into a framebuffer of its own, so the surface need not be
+    // exposed or as large as the image, nor a window at all
+    if (!initialized || size.isEmpty() || !makeContextCurrent()) {
+        qWarning() << "No OpenGL context to render an image with";
+        return QImage();
+    }
+
+    // The image gets its own projection and pixel size
+    int windowWidth = viewportWidth, windowHeight = viewportHeight;
+    QMatrix4x4 windowProjection = projection;
+    viewportWidth  = size.width();
+    viewportHeight = size.height();
+    projection.setToIdentity();
+    projection.perspective(45.0f, qreal(size.width())/qreal(size.height()), 0.1f, 10000.0f);
+
+    // Full quality, at the requested level rather than a preview
+    if (interacting) {
+        settleQuality();
+    }
+    progressive = false;
+    updateView();
+    if (needsPush) {
+        pushBuffers();
+    }
+    if (refining) {
+        waitInstances();
+    }
+    pushAssets();
+    waitAssets();
+    progressive = true;
+
+    QImage image;
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::Depth);
+    format.setSamples(imageSamples);
+    QOpenGLFramebufferObject fbo(size, format);
+    if (fbo.isValid()) {
+        fbo.bind();
+        glViewport(0, 0, size.width(), size.height());
+        drawScene();
+        // Resolves the samples before reading back
+        image = fbo.toImage();
+        fbo.release();
+    } else {
+        qWarning() << "Could not create a framebuffer of" << size << "for the image";
+    }
+
+    viewportWidth  = windowWidth;
+    viewportHeight = windowHeight;
+    projection     = windowProjection;
+    glViewport(0, 0, windowWidth, windowHeight);
+    requestRender();
+    return image;
+}
+
+void GLRenderer::requestImage(QSize size)
+{
+    emit imageRendered(renderImage(size));
+}
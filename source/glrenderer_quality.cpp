@@ -0,0 +1,210 @@
+#include <QtGui>
+#include "glrenderer.h"
+
+// Coarser glyph meshes are tried before coarser subsampling
+static const int maxLODBias = 2;
+static const int maxQualityDrop = maxLODBias + 4;
+
+// Frames to wait after a step, for the GPU timings to catch up
+static const int qualitySettleFrames = 3;
+
+// Time without view changes after which full quality is restored
+static const int qualitySettleMs = 300;
+
+// Render scale grows by this factor when frames are well within budget,
+// and is kept to multiples of renderScaleQuantum to limit reallocations
+static const float renderScaleStep = 1.25f;
+static const float renderScaleQuantum = 0.05f;
+
+void GLRenderer::setTargetFrameRate(int fps)
+{
+    targetFrameRate = qMax(0, fps);
+    if (targetFrameRate == 0) {
+        settleQuality();
+    }
+}
+
+void GLRenderer::setRenderScaleRange(float low, float high)
+{
+    minRenderScale = qBound(renderScaleQuantum, qMin(low, high), 1.0f);
+    maxRenderScale = qBound(minRenderScale, qMax(low, high), 1.0f);
+    if (interacting) {
+        setRenderScale(renderScale);
+    }
+}
+
+void GLRenderer::initializeFrameQueries()
+{
+    gl330Funcs->glGenQueries(3, frameQueries);
+    for (int i=0; i<3; i++) {
+        frameQueryIssued[i] = false;
+    }
+    frameQuery = 0;
+
+    settleTimer = new QTimer(this);
+    settleTimer->setSingleShot(true);
+    settleTimer->setInterval(qualitySettleMs);
+    connect(settleTimer, SIGNAL(timeout()), this, SLOT(settleQuality()));
+}
+
+void GLRenderer::beginFrameQuery()
+{
+    // The query issued three frames ago is usually done, so
+    // reading it never stalls the pipeline
+    GLuint query = frameQueries[frameQuery];
+    if (frameQueryIssued[frameQuery]) {
+        GLint available = 0;
+        gl330Funcs->glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 elapsed = 0;
+            gl330Funcs->glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            gpuFrameTime = elapsed*1.0e-6f;
+        }
+    }
+    gl330Funcs->glBeginQuery(GL_TIME_ELAPSED, query);
+    frameTimer.start();
+}
+
+void GLRenderer::endFrameQuery()
+{
+    gl330Funcs->glEndQuery(GL_TIME_ELAPSED);
+    frameQueryIssued[frameQuery] = true;
+    frameQuery = (frameQuery + 1) % 3;
+    cpuFrameTime = frameTimer.nsecsElapsed()*1.0e-6f;
+}
+
+void GLRenderer::beginInteraction()
+{
+    bool starting = !interacting;
+    interacting = true;
+    if (starting && targetFrameRate > 0) {
+        setRenderScale(maxRenderScale);
+    }
+    if (settleTimer) {
+        settleTimer->start();
+    }
+}
+
+void GLRenderer::settleQuality()
+{
+    interacting = false;
+    setQualityDrop(0);
+    setRenderScale(1.0f);
+}
+
+void GLRenderer::adaptQuality()
+{
+    if (!interacting || targetFrameRate <= 0) {
+        return;
+    }
+    if (qualityWait > 0) {
+        qualityWait--;
+        return;
+    }
+
+    // Half the budget of headroom before stepping back up, so the
+    // level does not flip between two neighbours
+    float budget = 1000.0f/targetFrameRate;
+    float frame  = qMax(cpuFrameTime, gpuFrameTime);
+    if (frame > budget) {
+        // Fill rate goes first, by the pixel count the budget allows
+        if (renderScale > minRenderScale) {
+            setRenderScale(renderScale*qSqrt(budget/frame));
+        } else if (qualityDrop < maxQualityDrop && numNodes > 1) {
+            setQualityDrop(qualityDrop + 1);
+        }
+    } else if (frame < 0.5f*budget) {
+        if (qualityDrop > 0) {
+            setQualityDrop(qualityDrop - 1);
+        } else if (renderScale < maxRenderScale) {
+            setRenderScale(renderScale*renderScaleStep);
+        }
+    }
+}
+
+void GLRenderer::setRenderScale(float scale)
+{
+    // Full resolution only when the view rests, so MSAA comes back with it
+    if (interacting) {
+        scale = qBound(minRenderScale, renderScaleQuantum*qFloor(scale/renderScaleQuantum + 0.5f), maxRenderScale);
+    } else {
+        scale = 1.0f;
+    }
+    if (scale == renderScale) {
+        return;
+    }
+    renderScale = scale;
+    qualityWait = qualitySettleFrames;
+    requestRender();
+}
+
+bool GLRenderer::bindSceneFramebuffer()
+{
+    // Reallocated only when the size changes, and kept between interactions
+    QSize size(qMax(1, qRound(viewportWidth*renderScale)), qMax(1, qRound(viewportHeight*renderScale)));
+    if (!sceneFbo || sceneFbo->size() != size) {
+        delete sceneFbo;
+        sceneFbo = new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::Depth);
+        if (!sceneFbo->isValid()) {
+            qWarning() << "Could not create the reduced resolution framebuffer";
+            delete sceneFbo;
+            sceneFbo = 0;
+            return false;
+        }
+        // Smoother than nearest when stretched
+        glBindTexture(GL_TEXTURE_2D, sceneFbo->texture());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    if (!upscaleVao) {
+        upscaleVao = new QOpenGLVertexArrayObject(this);
+        upscaleVao->create();
+    }
+    sceneFbo->bind();
+    glViewport(0, 0, size.width(), size.height());
+    return true;
+}
+
+void GLRenderer::drawUpscaled()
+{
+    sceneFbo->release();
+    glViewport(0, 0, viewportWidth, viewportHeight);
+    glDisable(GL_DEPTH_TEST);
+
+    upscaleShader.bind();
+    upscaleShader.setUniformValue("scene", 0);
+    gl330Funcs->glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, sceneFbo->texture());
+    upscaleVao->bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    upscaleVao->release();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    upscaleShader.release();
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+void GLRenderer::setQualityDrop(int drop)
+{
+    if (drop == qualityDrop) {
+        return;
+    }
+    int extra = extraSubsampling();
+    qualityDrop = drop;
+    qualityWait = qualitySettleFrames;
+    if (extraSubsampling() != extra) {
+        needsPush = true;
+    }
+    requestRender();
+}
+
+int GLRenderer::lodBias()
+{
+    return qMin(qualityDrop, maxLODBias);
+}
+
+int GLRenderer::extraSubsampling()
+{
+    return qMax(0, qualityDrop - maxLODBias);
+}
@@ -1,89 +1,52 @@
 #ifndef GLWIDGET_H
 #define GLWIDGET_H
-#define PI 3.1415926535897932384626433832795
 
 #include <QGLWidget>
-#include <QOpenGLBuffer>
-#include <QOpenGLFunctions_3_3_Core>
-#include <QOpenGLShaderProgram>
-#include <QOpenGLVertexArrayObject>
+#include <QSurface>
+#include <QThread>
+#include <QVector2D>
 
-#include "matrix.h"
-#include "OMFImport.h"
+#include "glrenderer.h"
 
-struct sprite
-{
-    QOpenGLBuffer vbo;
-    QOpenGLBuffer pos_vbo;
-    QOpenGLBuffer mag_vbo;
-    QOpenGLVertexArrayObject *vao;
-    GLuint count;
-};
+// Queued to the renderer, see GLWidget
+Q_DECLARE_METATYPE(QSharedPointer<OMFReader>)
+Q_DECLARE_METATYPE(QSurface*)
 
+// The viewport of the window. Holds the context and its window, and
+// turns input into view changes, while a GLRenderer does the drawing.
+// The renderer runs on a thread of its own where threaded OpenGL is
+// supported, so waiting for the builder never blocks the GUI. Calls are
+// queued to it, and images come back through its imageRendered signal.
 class GLWidget : public QGLWidget
 {
     Q_OBJECT
 public:
     GLWidget( const QGLFormat& format, QWidget* parent = 0 );
+    ~GLWidget();
+    GLRenderer *renderer();
 
-    // Data and Drawing
+    // Passed on to the renderer
     void updateData(QSharedPointer<OMFReader> data);
-//    void updateHeader(QSharedPointer<OMFHeader> header, QSharedPointer<matrix> data);
-    void isDoneRendering();
-    virtual void renderFrame(QString file);
-
-    // View Preferences
-    virtual void toggleDisplay(int type);
-    virtual void setBackgroundColor(QColor color);
-    virtual void setSpriteDimensions(int newslices, float length, float radius, float tipLengthRatio, float shaftRadiusRatio, QString origin);
-    virtual void setBrightness(float bright);
+    void requestImage(QSize size); // Offscreen, at any size
+    void toggleDisplay(int type);
+    void setBackgroundColor(QColor color);
+    void setSpriteDimensions(int newslices, float length, float radius, float tipLengthRatio, float shaftRadiusRatio, QString origin);
+    void setBrightness(float bright);
     void setColorScale(QString value);
     void setSpriteScale(QString value);
     void setColoredQuantity(QString value);
     void setCustomColorScale(QList<QColor> colors);
-
-public slots:
-    virtual void update();
-
-    // Movement and slicing
-    void setXRotation(int angle);
-    void setYRotation(int angle);
-    void setZRotation(int angle);
-    void setXSliceLow(int low);
-    void setYSliceLow(int low);
-    void setZSliceLow(int low);
-    void setThresholdLow(int low);
-    void setXSliceHigh(int high);
-    void setYSliceHigh(int high);
-    void setZSliceHigh(int high);
-    void setThresholdHigh(int high);
-    void setXCom(float val);
-    void setYCom(float val);
-    void setZCom(float val);
-    void setXLoc(float val);
-    void setYLoc(float val);
-    void setZLoc(float val);
-
-    // Subsampling
-    void increaseSubsampling();
-    void decreaseSubsampling();
-
-signals:
-    void xRotationChanged(int angle);
-    void yRotationChanged(int angle);
-    void zRotationChanged(int angle);
-    void COMChanged(float val);
-    void doneRenderingFrame(QString filename);
+    void setUploadTolerance(float percent);
+    void setTargetFrameRate(int fps);
+    void setRenderScaleRange(float low, float high);
+    void setFieldLineSeeds(QString value);
+    void setIsoComponent(QString value);
 
 protected:
-    virtual void updateCOM();
-    virtual void updateExtent();
-
-    virtual void initializeGL();
-    virtual void resizeGL( int w, int h );
-    virtual void paintGL();
-    virtual void pushBuffers();
-    virtual void pushLUT();
+    // The renderer draws and swaps on its own schedule
+    virtual void paintEvent(QPaintEvent *e);
+    virtual void resizeEvent(QResizeEvent *e);
+    virtual void showEvent(QShowEvent *e);
 
     virtual void keyPressEvent( QKeyEvent* e );
     virtual void mousePressEvent(QMouseEvent *e);
@@ -92,78 +55,11 @@ protected:
     virtual void wheelEvent(QWheelEvent *e);
 
 private:
-    // Shaders
-    QOpenGLShaderProgram standardShader, cubeShader;
-    QOpenGLShaderProgram *currentShader;
-    QOpenGLFunctions_3_3_Core* gl330Funcs;
-
-    // Init functions
-    void initializeAssets();
-    bool initializeShaders();
-    bool initializeLights();
-    bool initializeCube();
-    bool initializeCone(int slices, float radius, float height);
-    bool initializeVect(int slices, float height, float radius, float fractionTip, float fractionInner);
-
-    QVector<QVector4D> instPositions;
-    QVector<QVector4D> instMagnetizations;
-
-    // Sprites and Data
-    sprite cube, cone, vect;
-    sprite *displayObject;
-    int numNodes; // Number of nodes being displayed with current subsampling
-    int displayType; // Cube 0, Cone 1, Vector 2
-    int valuedim;    // scalar or vector
-    int subsampling; // display each 2^n'th cell according to this variable
-    QSharedPointer<OMFReader> dataPtr;
-    float maxmag, minmag;
-    QColor spriteColor;
-    int slices; // Resolution for cones/vects
-    float vectorLength, vectorRadius, vectorTipLengthRatio, vectorShaftRadiusRatio;
-
-    // Lighting
-    GLfloat   lightAmbient;
-    QVector4D lightIntensity;
-    QVector4D lightPosition;
-    float brightness;
-
-    // View Related
-    QSize mandatedSize;
-    QColor backgroundColor;
-    QMatrix4x4 projection, view, model;
-    bool displayOn;
-    QVector3D com, location, maxExtent, minExtent;
-    float xcom, ycom, zcom;
-    float xmax, ymax, zmax;
-    float xmin, ymin, zmin;
-    int xRot, yRot, zRot;
-    float xLoc, yLoc, zLoc, zoom;
-    // slice variables
-    int xSliceLow, xSliceHigh;
-    int ySliceLow, ySliceHigh;
-    int zSliceLow, zSliceHigh;
-    int thresholdLow, thresholdHigh;
-
-    // Coloring
-    QString colorScale;
-    QString coloredQuantity;
-    QString vectorOrigin;
-    QString spriteScale;
-    QColor customSpriteColor(float val); // val goes from 0 to 1.0
-    QList<QColor> customColors;
-    QMap<QString, int> display_type_map;
+    GLRenderer *sceneRenderer;
+    QThread *renderThread; // 0 when the renderer runs on the GUI thread
 
     // Mouse control
     QVector2D previousMousePosition;
-    bool leftMousePressed;
-    bool middleMousePressed;
-    bool rightMousePressed;
-
-    // Render control
-    bool needsUpdate;
-    QString filename; // for rendering image sequences...
-
 };
 
 #endif // GLWIDGET_H
-
@@ -0,0 +1,552 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLVertexArrayObject>
+#include <string.h>
+#include "instancebuilder.h"
+#include "glcontext.h"
+
+// Lattice cells per brick edge; bricks are the leaves of the instance octree
+static const int brickCells = 16;
+
+// Instances compared at a time when looking for changes since the last upload
+static const qint64 uploadBlock = 4096;
+
+instanceBuilder::instanceBuilder(QObject *parent)
+    : QThread(parent), requests(0), frames(0), latestGeneration(0), stopping(0),
+      uploadContext(0), uploadSurface(0), uploading(false), uploadedBytes(0),
+      freeSets(2), freeMask(3)
+{
+    for (int set=0; set<2; set++) {
+        allocated[set] = -1;
+        drawn[set] = 0;
+    }
+}
+
+instanceBuilder::~instanceBuilder()
+{
+    // Abandons the frame being built
+    stopping.storeRelease(1);
+    latestGeneration.fetchAndAddOrdered(1);
+    requested.release();
+    wait();
+    delete requests.fetchAndStoreOrdered(0);
+    delete frames.fetchAndStoreOrdered(0);
+    for (int kind=0; kind<assetKinds; kind++) {
+        delete jobs[kind].fetchAndStoreOrdered(0);
+        delete assets[kind].fetchAndStoreOrdered(0);
+    }
+    // Handed back to this thread when the builder thread ended
+    delete uploadContext;
+    delete uploadSurface;
+}
+
+bool instanceBuilder::shareContext(QOpenGLContext *context)
+{
+    // Surfaces belong to the GUI thread, so both are created here. The
+    // context moves to the builder thread now, as requests may come from
+    // the rendering thread, which cannot push it.
+    if (uploadContext) {
+        return true;
+    }
+    if (!context || !QOpenGLContext::supportsThreadedOpenGL()) {
+        qWarning() << "No OpenGL context for the instance builder, instances are uploaded by the renderer";
+        return false;
+    }
+    uploadContext = createGLContext(context->format(), context);
+    if (!uploadContext) {
+        qWarning() << "Could not create an OpenGL context shared with the renderer, instances are uploaded by the renderer";
+        return false;
+    }
+    uploadSurface = new QOffscreenSurface();
+    uploadSurface->setFormat(uploadContext->format());
+    uploadSurface->create();
+    uploadContext->moveToThread(this);
+    return true;
+}
+
+int instanceBuilder::request(const instanceRequest &req)
+{
+    instanceRequest *pending = new instanceRequest(req);
+    int generation = latestGeneration.fetchAndAddOrdered(1) + 1;
+    pending->generation = generation;
+    // A request the thread has not taken yet is ours to drop
+    delete requests.fetchAndStoreOrdered(pending);
+    requested.release();
+    if (!isRunning()) {
+        start();
+    }
+    return generation;
+}
+
+instanceFrame *instanceBuilder::take()
+{
+    return frames.fetchAndStoreOrdered(0);
+}
+
+instanceFrame *instanceBuilder::waitFinal(int generation, int timeout)
+{
+    // Every frame posted releases once, so taking after each
+    // acquire sees every frame that was not taken already
+    QElapsedTimer timer;
+    timer.start();
+    while (true) {
+        int left = timeout - (int)timer.elapsed();
+        if (left <= 0 || !posted.tryAcquire(1, left)) {
+            return 0;
+        }
+        instanceFrame *frame = take();
+        if (frame && frame->final && frame->generation == generation) {
+            return frame;
+        }
+        discard(frame);
+    }
+}
+
+void instanceBuilder::submit(assetJob *job)
+{
+    delete jobs[job->kind].fetchAndStoreOrdered(job);
+    requested.release();
+    if (!isRunning()) {
+        start();
+    }
+}
+
+assetJob *instanceBuilder::takeAsset(assetKind kind)
+{
+    return assets[kind].fetchAndStoreOrdered(0);
+}
+
+assetJob *instanceBuilder::waitAsset(assetKind kind, int generation, int timeout)
+{
+    // Wake-ups are shared by every kind, so the slot is looked at before each wait
+    QElapsedTimer timer;
+    timer.start();
+    while (true) {
+        assetJob *job = takeAsset(kind);
+        if (job && job->generation == generation) {
+            return job;
+        }
+        discardAsset(job);
+        int left = timeout - (int)timer.elapsed();
+        if (left <= 0) {
+            return 0;
+        }
+        assetsPosted.tryAcquire(1, left);
+    }
+}
+
+void instanceBuilder::discardAsset(assetJob *job)
+{
+    if (!job) {
+        return;
+    }
+    QOpenGLContext *current = QOpenGLContext::currentContext();
+    if (job->isUploaded && current) {
+        current->extraFunctions()->glDeleteSync(job->uploaded);
+        job->destroy();
+    }
+    delete job;
+}
+
+void instanceBuilder::release(int buffers, GLsync fence)
+{
+    if (buffers < 0) {
+        return;
+    }
+    drawn[buffers] = fence;
+    freeMask.fetchAndOrOrdered(1 << buffers);
+    freeSets.release();
+}
+
+void instanceBuilder::discard(instanceFrame *frame)
+{
+    if (!frame) {
+        return;
+    }
+    QOpenGLContext *current = QOpenGLContext::currentContext();
+    if (frame->uploaded && current) {
+        current->extraFunctions()->glDeleteSync(frame->uploaded);
+    }
+    release(frame->buffers, 0);
+    delete frame;
+}
+
+void instanceBuilder::run()
+{
+    uploading = uploadContext && uploadContext->makeCurrent(uploadSurface);
+    if (uploadContext && !uploading) {
+        qWarning() << "Could not make the instance upload context current, instances are uploaded by the renderer";
+    }
+    // Core profiles only bind index buffers with a vertex array bound
+    QOpenGLVertexArrayObject indexVao;
+    if (uploading) {
+        indexVao.create();
+        indexVao.bind();
+    }
+    while (true) {
+        requested.acquire();
+        if (stopping.loadAcquire()) {
+            break;
+        }
+        // Several wake-ups may have been coalesced into one request
+        instanceRequest *req = requests.fetchAndStoreOrdered(0);
+        if (req) {
+            bool built = true;
+            if (req->coarse > req->level) {
+                built = build(*req, req->coarse, false);
+            }
+            if (built) {
+                build(*req, req->level, true);
+            }
+            delete req;
+        }
+        for (int kind=0; kind<assetKinds; kind++) {
+            assetJob *job = jobs[kind].fetchAndStoreOrdered(0);
+            if (job) {
+                buildAsset(job);
+            }
+        }
+    }
+
+    // Buffers are deleted through the context they were made in
+    if (uploading) {
+        for (int set=0; set<2; set++) {
+            for (int s=0; s<positionBuffers[set].size(); s++) {
+                positionBuffers[set][s].destroy();
+                vectorBuffers[set][s].destroy();
+            }
+        }
+        for (int kind=0; kind<assetKinds; kind++) {
+            discardAsset(assets[kind].fetchAndStoreOrdered(0));
+        }
+        indexVao.destroy();
+        uploadContext->doneCurrent();
+    }
+    if (uploadContext) {
+        uploadContext->moveToThread(QCoreApplication::instance()->thread());
+    }
+}
+
+bool instanceBuilder::build(const instanceRequest &req, int level, bool final)
+{
+    // Every incr-th cell of the grid, averaged when the pyramid has the level.
+    // The preview strides the grid unless its level is already built.
+    matrix *field = req.data->field.data();
+    QVector<int> size = field->shape();
+    instanceLattice lattice;
+    lattice.source = (final || field->hasLevel(level)) ? field->level(level) : 0;
+    int bricks[3];
+    for (int axis=0; axis<3; axis++) {
+        lattice.incr[axis]   = qMin(1 << level, size[axis]);
+        lattice.stride[axis] = lattice.source ? 1 : lattice.incr[axis];
+        lattice.size[axis]   = (size[axis] + lattice.incr[axis] - 1)/lattice.incr[axis];
+        bricks[axis] = (lattice.size[axis] + brickCells - 1)/brickCells;
+    }
+    if (!lattice.source) {
+        lattice.source = field;
+    }
+    lattice.invScale = 1.0f/req.scale;
+
+    instanceFrame *frame = new instanceFrame;
+    frame->level      = level;
+    frame->generation = req.generation;
+    frame->final      = final;
+    frame->tolerance  = req.tolerance;
+    frame->buffers    = -1;
+    frame->uploaded   = 0;
+    frame->uploadedPercent = 0.0f;
+
+    int origin[3] = { 0, 0, 0 };
+    QVector<instanceLeaf> leaves;
+    pushNode(origin, bricks, lattice, frame->nodes, leaves);
+    for (int l=0; l<leaves.size(); l++) {
+        if (latestGeneration.loadAcquire() != req.generation) {
+            delete frame;
+            return false;
+        }
+        fillLeaf(leaves[l], lattice, req, *frame);
+    }
+    finishNode(frame->nodes, 0);
+
+    // A frame the renderer has not taken yet is ours to drop, and its buffers
+    // with it. The renderer only waits on the fence before drawing this one.
+    if (uploading) {
+        discard(frames.fetchAndStoreOrdered(0));
+        if (!upload(*frame)) {
+            delete frame;
+            return false;
+        }
+        QOpenGLExtraFunctions *gl = uploadContext->extraFunctions();
+        frame->uploaded = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        gl->glFlush();
+    }
+    discard(frames.fetchAndStoreOrdered(frame));
+    posted.release();
+    emit frameReady();
+    return true;
+}
+
+void instanceBuilder::buildAsset(assetJob *job)
+{
+    job->extract();
+    // The renderer only waits on the fence before drawing it, as for instances
+    if (uploading) {
+        job->upload();
+        QOpenGLExtraFunctions *gl = uploadContext->extraFunctions();
+        job->uploaded = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        gl->glFlush();
+        job->isUploaded = true;
+    }
+    discardAsset(assets[job->kind].fetchAndStoreOrdered(job));
+    assetsPosted.release();
+    emit frameReady();
+}
+
+int instanceBuilder::pushNode(const int low[3], const int high[3], const instanceLattice &lattice,
+                              QVector<instanceNode> &nodes, QVector<instanceLeaf> &leaves)
+{
+    // Bricks [low, high), halved along each axis down to single bricks.
+    // Leaves are filled afterwards, in the order they are listed.
+    int index = nodes.size();
+    instanceNode node;
+    node.first = 0;
+    node.count = 0;
+    for (int c=0; c<8; c++) {
+        node.children[c] = -1;
+    }
+    for (int axis=0; axis<3; axis++) {
+        node.low[axis]  = low[axis]*brickCells*lattice.incr[axis];
+        node.high[axis] = (qMin(high[axis]*brickCells, lattice.size[axis]) - 1)*lattice.incr[axis];
+    }
+    nodes << node;
+
+    if (high[0] - low[0] == 1 && high[1] - low[1] == 1 && high[2] - low[2] == 1) {
+        instanceLeaf leaf;
+        leaf.node = index;
+        for (int axis=0; axis<3; axis++) {
+            leaf.begin[axis] = low[axis]*brickCells;
+            leaf.end[axis]   = qMin(high[axis]*brickCells, lattice.size[axis]);
+        }
+        leaves << leaf;
+    } else {
+        int mid[3];
+        for (int axis=0; axis<3; axis++) {
+            mid[axis] = low[axis] + (high[axis] - low[axis] + 1)/2;
+        }
+        for (int c=0; c<8; c++) {
+            int childLow[3], childHigh[3];
+            bool empty = false;
+            for (int axis=0; axis<3; axis++) {
+                childLow[axis]  = (c & (1 << axis)) ? mid[axis]  : low[axis];
+                childHigh[axis] = (c & (1 << axis)) ? high[axis] : mid[axis];
+                empty = empty || childLow[axis] >= childHigh[axis];
+            }
+            if (!empty) {
+                int child = pushNode(childLow, childHigh, lattice, nodes, leaves);
+                nodes[index].children[c] = child;
+            }
+        }
+    }
+    return index;
+}
+
+void instanceBuilder::fillLeaf(const instanceLeaf &leaf, const instanceLattice &lattice,
+                               const instanceRequest &req, instanceFrame &frame)
+{
+    int begin[3], end[3];
+    for (int axis=0; axis<3; axis++) {
+        begin[axis] = leaf.begin[axis];
+        end[axis]   = leaf.end[axis];
+    }
+    // Bricks outside the slice box are not read from disk at all
+    if (req.streamed) {
+        for (int axis=0; axis<3; axis++) {
+            if ((end[axis] - 1)*lattice.incr[axis] < req.sliceLow[axis] || begin[axis]*lattice.incr[axis] > req.sliceHigh[axis]) {
+                end[0] = begin[0];
+            }
+        }
+    }
+    instanceNode &node = frame.nodes[leaf.node];
+    node.first = (qint64)frame.positions.size();
+    for(int i=begin[0]; i<end[0]; i++) {
+        for(int j=begin[1]; j<end[1]; j++) {
+            for(int k=begin[2]; k<end[2]; k++) {
+                int x = i*lattice.incr[0], y = j*lattice.incr[1], z = k*lattice.incr[2];
+                int sx = i*lattice.stride[0], sy = j*lattice.stride[1], sz = k*lattice.stride[2];
+                if (!lattice.source->occupied(sx,sy,sz)) {
+                    continue; // Vacuum has no glyph
+                }
+                QVector3D m = lattice.source->at(sx,sy,sz) * lattice.invScale;
+                instancePosition p = { (GLushort)x, (GLushort)y, (GLushort)z }; // See GLWidget::packedPositionsFit
+                instanceVector   v = { packSnorm16(m.x()), packSnorm16(m.y()), packSnorm16(m.z()) };
+                frame.positions.push_back(p);
+                frame.magnetizations.push_back(v);
+            }
+        }
+    }
+    node.count = (qint64)frame.positions.size() - node.first;
+}
+
+void instanceBuilder::finishNode(QVector<instanceNode> &nodes, int index)
+{
+    // Leaves were filled depth first, so the instances of a node follow
+    // on from those of its first child
+    bool first = true;
+    for (int c=0; c<8; c++) {
+        int child = nodes[index].children[c];
+        if (child < 0) {
+            continue;
+        }
+        finishNode(nodes, child);
+        if (first) {
+            nodes[index].first = nodes[child].first;
+            nodes[index].count = 0;
+            first = false;
+        }
+        nodes[index].count += nodes[child].count;
+    }
+}
+
+int instanceBuilder::takeBuffers(int generation)
+{
+    // Waits for the renderer to draw from the set posted last, or for a newer request
+    while (!freeSets.tryAcquire(1, 10)) {
+        if (latestGeneration.loadAcquire() != generation) {
+            return -1;
+        }
+    }
+    // Only the uploading thread ever takes a set, the renderer only gives them back
+    int set = (freeMask.loadAcquire() & 1) ? 0 : 1;
+    freeMask.fetchAndAndOrdered(~(1 << set));
+    // Writes to the set wait on the GPU for the draws the renderer issued from it
+    if (drawn[set]) {
+        QOpenGLExtraFunctions *gl = QOpenGLContext::currentContext()->extraFunctions();
+        gl->glWaitSync(drawn[set], 0, GL_TIMEOUT_IGNORED);
+        gl->glDeleteSync(drawn[set]);
+        drawn[set] = 0;
+    }
+    return set;
+}
+
+bool instanceBuilder::upload(instanceFrame &frame)
+{
+    int set = takeBuffers(frame.generation);
+    if (set < 0) {
+        return false;
+    }
+    qint64 count  = (qint64)frame.positions.size();
+    qint64 blocks = (count + uploadBlock - 1)/uploadBlock;
+    uploadedBytes = 0;
+
+    // Blocks that changed since the last upload are stale in both sets.
+    // Blocks within the tolerance keep what was uploaded, so the error
+    // never accumulates.
+    if ((qint64)uploadedPositions.size() != count) {
+        uploadedPositions.swap(frame.positions);
+        uploadedMagnetizations.swap(frame.magnetizations);
+        for (int s=0; s<2; s++) {
+            stale[s].assign(blocks, 3);
+        }
+    } else {
+        int tolerance = (int)(frame.tolerance*32767.0f);
+        for (qint64 block=0; block<blocks; block++) {
+            qint64 first = block*uploadBlock;
+            qint64 end   = qMin(first + uploadBlock, count);
+            if (memcmp(&frame.positions[first], &uploadedPositions[first], (end - first)*sizeof(instancePosition)) != 0) {
+                memcpy(&uploadedPositions[first], &frame.positions[first], (end - first)*sizeof(instancePosition));
+                stale[0][block] |= 1;
+                stale[1][block] |= 1;
+            }
+            bool magDirty = false;
+            for (qint64 i=first; i<end && !magDirty; i++) {
+                const instanceVector &a = frame.magnetizations[i];
+                const instanceVector &b = uploadedMagnetizations[i];
+                magDirty = qAbs(a.x - b.x) > tolerance || qAbs(a.y - b.y) > tolerance || qAbs(a.z - b.z) > tolerance;
+            }
+            if (magDirty) {
+                memcpy(&uploadedMagnetizations[first], &frame.magnetizations[first], (end - first)*sizeof(instanceVector));
+                stale[0][block] |= 2;
+                stale[1][block] |= 2;
+            }
+        }
+    }
+    std::vector<instancePosition>().swap(frame.positions);
+    std::vector<instanceVector>().swap(frame.magnetizations);
+
+    // One pair of buffers per instancesPerBuffer instances, the first always
+    // kept. A set allocated for another count is written in full.
+    if (allocated[set] != count) {
+        int segments = qMax((qint64)1, (count + instancesPerBuffer - 1)/instancesPerBuffer);
+        while (positionBuffers[set].size() < segments) {
+            QOpenGLBuffer pos_vbo(QOpenGLBuffer::VertexBuffer);
+            QOpenGLBuffer mag_vbo(QOpenGLBuffer::VertexBuffer);
+            pos_vbo.create();
+            mag_vbo.create();
+            pos_vbo.setUsagePattern( QOpenGLBuffer::DynamicDraw );
+            mag_vbo.setUsagePattern( QOpenGLBuffer::DynamicDraw );
+            positionBuffers[set] << pos_vbo;
+            vectorBuffers[set] << mag_vbo;
+        }
+        while (positionBuffers[set].size() > segments) {
+            positionBuffers[set].last().destroy();
+            vectorBuffers[set].last().destroy();
+            positionBuffers[set].removeLast();
+            vectorBuffers[set].removeLast();
+        }
+        for (int s=0; s<segments; s++) {
+            qint64 first = s*instancesPerBuffer;
+            int segmentCount = (int)qMax((qint64)0, qMin(instancesPerBuffer, count - first));
+            positionBuffers[set][s].bind();
+            positionBuffers[set][s].allocate( segmentCount * sizeof(instancePosition) );
+            vectorBuffers[set][s].bind();
+            vectorBuffers[set][s].allocate( segmentCount * sizeof(instanceVector) );
+        }
+        allocated[set] = count;
+        stale[set].assign(blocks, 3);
+    }
+
+    // Runs of stale blocks go out with glBufferSubData
+    for (int bit=1; bit<=2; bit++) {
+        qint64 run = -1;
+        for (qint64 block=0; block<=blocks; block++) {
+            bool dirty = block < blocks && (stale[set][block] & bit);
+            if (dirty && run < 0) {
+                run = block;
+            } else if (!dirty && run >= 0) {
+                writeInstances(set, run*uploadBlock, qMin(block*uploadBlock, count), bit == 1);
+                run = -1;
+            }
+        }
+    }
+    stale[set].assign(blocks, 0);
+    vectorBuffers[set].first().release();
+
+    frame.buffers         = set;
+    frame.positionBuffers = positionBuffers[set];
+    frame.vectorBuffers   = vectorBuffers[set];
+    qint64 totalBytes = count*(sizeof(instancePosition) + sizeof(instanceVector));
+    frame.uploadedPercent = totalBytes > 0 ? 100.0f*uploadedBytes/totalBytes : 0.0f;
+    return true;
+}
+
+void instanceBuilder::writeInstances(int set, qint64 first, qint64 end, bool positions)
+{
+    // Copies [first, end) of the last upload into the buffers of a set
+    while (first < end) {
+        int segment = (int)(first/instancesPerBuffer);
+        qint64 local = first - segment*instancesPerBuffer;
+        qint64 count = qMin(end - first, instancesPerBuffer - local);
+        if (positions) {
+            positionBuffers[set][segment].bind();
+            positionBuffers[set][segment].write(local*sizeof(instancePosition), &uploadedPositions[first], count*sizeof(instancePosition));
+            uploadedBytes += count*sizeof(instancePosition);
+        } else {
+            vectorBuffers[set][segment].bind();
+            vectorBuffers[set][segment].write(local*sizeof(instanceVector), &uploadedMagnetizations[first], count*sizeof(instanceVector));
+            uploadedBytes += count*sizeof(instanceVector);
+        }
+        first += count;
+    }
+}
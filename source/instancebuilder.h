@@ -0,0 +1,191 @@
+#ifndef INSTANCEBUILDER_H
+#define INSTANCEBUILDER_H
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QOffscreenSurface>
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QThread>
+#include <QVector>
+#include <QVector3D>
+#include <qopengl.h>
+#include <vector>
+#include "matrix.h"
+#include "OMFImport.h"
+
+// Packed per-instance attributes: grid coordinates as plain
+// unsigned shorts, vector components as snorm16 relative to
+// instanceScale. 12 bytes per cell instead of two QVector4Ds.
+struct instancePosition
+{
+    GLushort x, y, z;
+};
+
+struct instanceVector
+{
+    GLshort x, y, z;
+};
+
+// Instances per instance buffer, well below what drivers and
+// QOpenGLBuffer's int sizes can allocate in one piece
+static const qint64 instancesPerBuffer = 1 << 24;
+
+static inline GLshort packSnorm16(float val)
+{
+    // NaN comparisons fail, so vacuum cells end up as zero vectors
+    if (!(val > -1.0f)) val = (val <= -1.0f) ? -1.0f : 0.0f;
+    if (val > 1.0f) val = 1.0f;
+    return (GLshort)qRound(val*32767.0f);
+}
+
+// Cells glyph instances are pushed from: every incr-th cell of the grid,
+// read from the matching pyramid level or else strided from the grid
+struct instanceLattice
+{
+    matrix *source;
+    int incr[3];   // Grid cells per lattice cell
+    int stride[3]; // Source cells per lattice cell
+    int size[3];   // Lattice cells
+    float invScale;
+};
+
+// Node of the octree over the bricks of instances. The instances
+// of a node are contiguous, so a node can be drawn with one call.
+struct instanceNode
+{
+    QVector3D low, high; // Grid box of its cells
+    qint64 first;
+    qint64 count;
+    int children[8];     // -1 where there is none
+};
+
+// Brick of lattice cells [begin, end) filling an octree leaf
+struct instanceLeaf
+{
+    int node;
+    int begin[3], end[3];
+};
+
+// Glyph instances wanted for a frame at a subsampling level, preceded
+// by a preview at a coarser level when coarse is above it
+struct instanceRequest
+{
+    QSharedPointer<OMFReader> data;
+    int level;
+    int coarse;
+    bool streamed;       // Only bricks within the slice box are read
+    QVector3D sliceLow, sliceHigh;
+    float scale;         // Magnitude that maps to +/-1
+    float tolerance;     // Largest change of a vector component left out of an upload
+    int generation;
+};
+
+// Instances and their octree. Uploaded on the builder thread when it
+// has a context of its own, else staged for upload by the renderer.
+struct instanceFrame
+{
+    std::vector<instancePosition> positions; // Empty once uploaded
+    std::vector<instanceVector> magnetizations;
+    QVector<instanceNode> nodes; // Root first
+    int level;
+    int generation; // Of the request it was built for
+    bool final;     // Not a coarse preview
+    float tolerance;
+    int buffers;    // Set of instance buffers holding it, -1 until uploaded
+    QVector<QOpenGLBuffer> positionBuffers, vectorBuffers;
+    GLsync uploaded; // Signalled once the GPU has the upload
+    float uploadedPercent; // Of its instance data that had to be written
+};
+
+// Meshes and textures drawn besides the glyphs, one mailbox slot each
+enum assetKind { filmKind, volumeKind, surfaceKind, fieldLineKind, isoKind, assetKinds };
+
+// Extracts one mesh or texture, then uploads it into GL objects of its
+// own, so the renderer keeps drawing the previous ones until it swaps them in
+class assetJob
+{
+public:
+    assetJob(assetKind k) : kind(k), generation(0), uploaded(0), isUploaded(false) {}
+    virtual ~assetJob() {}
+    virtual void extract() = 0; // On the builder thread, no context needed
+    virtual void upload() = 0;  // With a context of the share group current
+    virtual void destroy() = 0; // Deletes what upload made, likewise
+    assetKind kind;
+    int generation;  // Numbered by the renderer, per kind
+    GLsync uploaded; // Signalled once the GPU has the upload
+    bool isUploaded; // Else the renderer uploads it
+};
+
+// Builds and uploads glyph instances on a thread of its own, so reading,
+// decimating and uploading large frames never blocks the renderer. Requests
+// and finished frames each pass through a single-slot mailbox: a newer
+// request replaces one not yet started and abandons the one being built,
+// and a newer frame replaces one not yet taken.
+//
+// Uploads alternate between two sets of instance buffers, shared with the
+// context of the renderer: it draws from one while the other is written.
+// A set goes back to the builder with a fence on the last draw from it.
+//
+// Film, volume, surface, field line and isosurface jobs are run after
+// the instances, through a single-slot mailbox per kind.
+class instanceBuilder : public QThread
+{
+    Q_OBJECT
+public:
+    instanceBuilder(QObject *parent = 0);
+    ~instanceBuilder();
+    bool shareContext(QOpenGLContext *context); // On the GUI thread, before the first request
+    int request(const instanceRequest &req); // Returns the generation of the request
+    instanceFrame *take();                   // Latest frame or 0, owned by the caller
+    instanceFrame *waitFinal(int generation, int timeout); // 0 after timeout ms
+    bool upload(instanceFrame &frame);       // With a context of the share group current
+    void release(int buffers, GLsync drawn); // The renderer no longer draws from the set
+    void discard(instanceFrame *frame);      // Deletes a frame that was never drawn
+    void submit(assetJob *job);              // Replaces a job of its kind not yet started
+    assetJob *takeAsset(assetKind kind);     // Latest job of the kind or 0, owned by the caller
+    assetJob *waitAsset(assetKind kind, int generation, int timeout); // 0 after timeout ms
+    void discardAsset(assetJob *job);        // Deletes a job that was never drawn
+
+signals:
+    void frameReady();
+
+protected:
+    void run();
+
+private:
+    bool build(const instanceRequest &req, int level, bool final);
+    int  pushNode(const int low[3], const int high[3], const instanceLattice &lattice,
+                  QVector<instanceNode> &nodes, QVector<instanceLeaf> &leaves);
+    void fillLeaf(const instanceLeaf &leaf, const instanceLattice &lattice,
+                  const instanceRequest &req, instanceFrame &frame);
+    void finishNode(QVector<instanceNode> &nodes, int index);
+    int  takeBuffers(int generation);
+    void writeInstances(int set, qint64 first, qint64 end, bool positions);
+    void buildAsset(assetJob *job);
+
+    QAtomicPointer<instanceRequest> requests; // To the thread
+    QAtomicPointer<instanceFrame> frames;     // From the thread
+    QAtomicPointer<assetJob> jobs[assetKinds];   // To the thread
+    QAtomicPointer<assetJob> assets[assetKinds]; // From the thread
+    QSemaphore requested, posted, assetsPosted;  // Only for sleeping on the mailboxes
+    QAtomicInt latestGeneration;
+    QAtomicInt stopping;
+
+    // Uploads, see shareContext
+    QOpenGLContext *uploadContext;
+    QOffscreenSurface *uploadSurface;
+    bool uploading; // uploadContext is current on the builder thread
+    QVector<QOpenGLBuffer> positionBuffers[2], vectorBuffers[2];
+    qint64 allocated[2];           // Instances each set was allocated for
+    std::vector<char> stale[2];    // Per upload block, what a set lacks of the last upload
+    std::vector<instancePosition> uploadedPositions; // What the latest set holds
+    std::vector<instanceVector> uploadedMagnetizations;
+    qint64 uploadedBytes;
+    QSemaphore freeSets;           // Sets neither drawn nor being written
+    QAtomicInt freeMask;
+    GLsync drawn[2];               // Last draw from a set released by the renderer
+};
+
+#endif // INSTANCEBUILDER_H
@@ -0,0 +1,267 @@
+#include <QtConcurrent>
+#include <QHash>
+#include <math.h>
+#include "isosurface.h"
+
+// Cells per brick edge when skipping empty regions
+static const int brickSize = 8;
+
+// Samples the quantity, then the brick ranges, of one x-slab of bricks
+struct isoSampleSlab
+{
+    isosurfaceExtractor *extractor;
+    int component;
+    float offset, scale;
+    bool ranges;
+
+    void operator()(const int &bx) const
+    {
+        isosurfaceExtractor &e = *extractor;
+        int x0 = bx*brickSize, x1 = qMin(x0 + brickSize, e.size[0] - 1);
+        if (!ranges) {
+            // The last slab also takes the points beyond the last brick
+            int end = (bx == e.bricks[0] - 1) ? e.size[0] : x0 + brickSize;
+            for (int z=0; z<e.size[2]; z++) {
+                for (int y=0; y<e.size[1]; y++) {
+                    for (int x=x0; x<end; x++) {
+                        QVector3D v = e.field->at(x, y, z);
+                        float components[3] = { v.x(), v.y(), v.z() };
+                        e.quantity[e.pointIndex(x, y, z)] = (components[component] - offset)*scale;
+                    }
+                }
+            }
+            return;
+        }
+
+        // Bricks cover the cubes, so they include the points of their far faces
+        for (int bz=0; bz<e.bricks[2]; bz++) {
+            for (int by=0; by<e.bricks[1]; by++) {
+                float low = HUGE_VALF, high = -HUGE_VALF;
+                int y0 = by*brickSize, y1 = qMin(y0 + brickSize, e.size[1] - 1);
+                int z0 = bz*brickSize, z1 = qMin(z0 + brickSize, e.size[2] - 1);
+                for (int z=z0; z<=z1; z++) {
+                    for (int y=y0; y<=y1; y++) {
+                        for (int x=x0; x<=x1; x++) {
+                            float q = e.quantity[e.pointIndex(x, y, z)];
+                            low  = qMin(low, q);
+                            high = qMax(high, q);
+                        }
+                    }
+                }
+                e.brickMin[e.brickIndex(bx, by, bz)] = low;
+                e.brickMax[e.brickIndex(bx, by, bz)] = high;
+            }
+        }
+    }
+};
+
+// Marches the cubes of one x-slab of bricks
+struct isoExtractSlab
+{
+    typedef isoMesh result_type;
+
+    const isosurfaceExtractor *extractor;
+    float iso;
+    int low[3], high[3]; // Points, inclusive
+
+    isoMesh operator()(const int &bx) const
+    {
+        const isosurfaceExtractor &e = *extractor;
+        isoMesh mesh;
+        QHash<qint64, unsigned int> edges; // Shared vertices, keyed by lower point and direction
+
+        // Tetrahedra around the main diagonal, as cube corners (bit 0 = x, 1 = y, 2 = z)
+        static const int tetrahedra[6][4] = {
+            {0, 1, 3, 7}, {0, 1, 5, 7}, {0, 2, 3, 7},
+            {0, 2, 6, 7}, {0, 4, 5, 7}, {0, 4, 6, 7}
+        };
+
+        for (int bz=0; bz<e.bricks[2]; bz++) {
+            for (int by=0; by<e.bricks[1]; by++) {
+                int brick = e.brickIndex(bx, by, bz);
+                if (!(e.brickMin[brick] <= iso && e.brickMax[brick] >= iso)) {
+                    continue;
+                }
+
+                int x0 = qMax(bx*brickSize, low[0]), x1 = qMin((bx+1)*brickSize, high[0]);
+                int y0 = qMax(by*brickSize, low[1]), y1 = qMin((by+1)*brickSize, high[1]);
+                int z0 = qMax(bz*brickSize, low[2]), z1 = qMin((bz+1)*brickSize, high[2]);
+                for (int z=z0; z<z1; z++) {
+                    for (int y=y0; y<y1; y++) {
+                        for (int x=x0; x<x1; x++) {
+                            float q[8];
+                            int inside = 0;
+                            for (int c=0; c<8; c++) {
+                                q[c] = e.quantity[e.pointIndex(x + (c & 1), y + ((c >> 1) & 1), z + ((c >> 2) & 1))];
+                                inside += (q[c] < iso) ? 1 : 0;
+                            }
+                            if (inside == 0 || inside == 8) {
+                                continue;
+                            }
+
+                            for (int t=0; t<6; t++) {
+                                const int *tet = tetrahedra[t];
+                                int in[4], out[4], numIn = 0, numOut = 0;
+                                for (int k=0; k<4; k++) {
+                                    if (q[tet[k]] < iso) {
+                                        in[numIn++] = tet[k];
+                                    } else {
+                                        out[numOut++] = tet[k];
+                                    }
+                                }
+
+                                if (numIn == 1 || numIn == 3) {
+                                    // One corner cut off
+                                    int lone    = (numIn == 1) ? in[0] : out[0];
+                                    int *others = (numIn == 1) ? out : in;
+                                    addTriangle(mesh, edges, x, y, z, q,
+                                                lone, others[0], lone, others[1], lone, others[2]);
+                                } else if (numIn == 2) {
+                                    // Quad between the two pairs
+                                    addTriangle(mesh, edges, x, y, z, q,
+                                                in[0], out[0], in[0], out[1], in[1], out[1]);
+                                    addTriangle(mesh, edges, x, y, z, q,
+                                                in[0], out[0], in[1], out[1], in[1], out[0]);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return mesh;
+    }
+
+    void addTriangle(isoMesh &mesh, QHash<qint64, unsigned int> &edges, int x, int y, int z, const float q[8],
+                     int a0, int b0, int a1, int b1, int a2, int b2) const
+    {
+        mesh.indices << edgeVertex(mesh, edges, x, y, z, q, a0, b0);
+        mesh.indices << edgeVertex(mesh, edges, x, y, z, q, a1, b1);
+        mesh.indices << edgeVertex(mesh, edges, x, y, z, q, a2, b2);
+    }
+
+    unsigned int edgeVertex(isoMesh &mesh, QHash<qint64, unsigned int> &edges, int x, int y, int z, const float q[8],
+                            int a, int b) const
+    {
+        // Every tetrahedron edge runs along a non-negative direction,
+        // so the corner with fewer bits set is the lower end
+        if ((a & b) != a) {
+            int swap = a;
+            a = b;
+            b = swap;
+        }
+        const isosurfaceExtractor &e = *extractor;
+        int pa[3] = { x + (a & 1), y + ((a >> 1) & 1), z + ((a >> 2) & 1) };
+        int pb[3] = { x + (b & 1), y + ((b >> 1) & 1), z + ((b >> 2) & 1) };
+        qint64 key = (qint64)e.pointIndex(pa[0], pa[1], pa[2])*7 + ((a ^ b) - 1);
+
+        QHash<qint64, unsigned int>::const_iterator found = edges.constFind(key);
+        if (found != edges.constEnd()) {
+            return found.value();
+        }
+
+        float t = (iso - q[a])/(q[b] - q[a]);
+        QVector3D A(pa[0], pa[1], pa[2]), B(pb[0], pb[1], pb[2]);
+        QVector3D normal = e.gradient(pa[0], pa[1], pa[2])*(1.0f - t) + e.gradient(pb[0], pb[1], pb[2])*t;
+        if (normal.lengthSquared() > 0.0f) {
+            normal.normalize();
+        } else {
+            normal = QVector3D(0.0f, 0.0f, 1.0f);
+        }
+
+        unsigned int index = mesh.positions.size();
+        mesh.positions << A*(1.0f - t) + B*t;
+        mesh.normals   << normal;
+        mesh.values    << e.field->at(pa[0], pa[1], pa[2])*(1.0f - t) + e.field->at(pb[0], pb[1], pb[2])*t;
+        mesh.edges     << key;
+        edges.insert(key, index);
+        return index;
+    }
+};
+
+isosurfaceExtractor::isosurfaceExtractor(QSharedPointer<matrix> field, int component, float offset, float scale)
+    : field(field)
+{
+    size = field->shape();
+    for (int axis=0; axis<3; axis++) {
+        bricks[axis] = qMax(1, (size[axis] - 1 + brickSize - 1)/brickSize);
+    }
+    quantity.resize((size_t)size[0]*size[1]*size[2]);
+    brickMin.resize(bricks[0]*bricks[1]*bricks[2]);
+    brickMax.resize(bricks[0]*bricks[1]*bricks[2]);
+
+    QVector<int> slabs;
+    for (int bx=0; bx<bricks[0]; bx++) {
+        slabs << bx;
+    }
+    isoSampleSlab sampler = { this, component, offset, scale, false };
+    QtConcurrent::blockingMap(slabs, sampler);
+    sampler.ranges = true;
+    QtConcurrent::blockingMap(slabs, sampler);
+}
+
+QVector3D isosurfaceExtractor::gradient(int x, int y, int z) const
+{
+    // Central differences, one-sided at the boundary
+    int p[3] = { x, y, z };
+    float g[3];
+    for (int axis=0; axis<3; axis++) {
+        int lo[3] = { x, y, z }, hi[3] = { x, y, z };
+        lo[axis] = qMax(p[axis] - 1, 0);
+        hi[axis] = qMin(p[axis] + 1, size[axis] - 1);
+        if (hi[axis] == lo[axis]) {
+            g[axis] = 0.0f;
+        } else {
+            g[axis] = (quantity[pointIndex(hi[0], hi[1], hi[2])] - quantity[pointIndex(lo[0], lo[1], lo[2])])/(hi[axis] - lo[axis]);
+        }
+    }
+    return QVector3D(g[0], g[1], g[2]);
+}
+
+isoMesh isosurfaceExtractor::extract(float iso, QVector3D low, QVector3D high)
+{
+    isoExtractSlab slab;
+    slab.extractor = this;
+    slab.iso       = iso;
+    for (int axis=0; axis<3; axis++) {
+        slab.low[axis]  = qMax(0, (int)ceilf(low[axis]));
+        slab.high[axis] = qMin(size[axis] - 1, (int)floorf(high[axis]));
+    }
+
+    QVector<int> slabs;
+    for (int bx=0; bx<bricks[0]; bx++) {
+        slabs << bx;
+    }
+    QVector<isoMesh> parts = QtConcurrent::blockingMapped<QVector<isoMesh> >(slabs, slab);
+
+    // Weld the vertices on the planes between slabs, which
+    // lie on edges running within the plane (no x direction)
+    isoMesh mesh;
+    QHash<qint64, unsigned int> seams;
+    for (int i=0; i<parts.size(); i++) {
+        const isoMesh &part = parts[i];
+        QVector<unsigned int> remap(part.positions.size());
+        for (int v=0; v<part.positions.size(); v++) {
+            qint64 key = part.edges[v];
+            int x = (int)((key/7) % size[0]);
+            bool seam = (x % brickSize == 0) && !(((key % 7) + 1) & 1);
+            if (seam) {
+                QHash<qint64, unsigned int>::const_iterator found = seams.constFind(key);
+                if (found != seams.constEnd()) {
+                    remap[v] = found.value();
+                    continue;
+                }
+                seams.insert(key, mesh.positions.size());
+            }
+            remap[v] = mesh.positions.size();
+            mesh.positions << part.positions[v];
+            mesh.normals   << part.normals[v];
+            mesh.values    << part.values[v];
+            mesh.edges     << key;
+        }
+        for (int j=0; j<part.indices.size(); j++) {
+            mesh.indices << remap[part.indices[j]];
+        }
+    }
+    return mesh;
+}
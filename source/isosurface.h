@@ -0,0 +1,48 @@
+#ifndef ISOSURFACE_H
+#define ISOSURFACE_H
+#include <QVector>
+#include <QVector3D>
+#include <QSharedPointer>
+#include <vector>
+#include "matrix.h"
+
+// Indexed triangle mesh, in grid coordinates
+struct isoMesh
+{
+    QVector<QVector3D> positions;
+    QVector<QVector3D> normals;
+    QVector<QVector3D> values; // Interpolated field, for coloring
+    QVector<unsigned int> indices;
+    QVector<qint64> edges;     // Grid edge each vertex lies on, for welding
+
+};
+
+// Extracts isosurfaces of one component of a vector field, or of a scalar
+// field, by marching over the grid cubes. Each cube is split into six
+// tetrahedra around its main diagonal, which needs no case tables and has
+// no ambiguous configurations. The sampled quantity and its range over
+// each brick of cells are kept, so a new iso-value only visits the bricks
+// the surface passes through.
+class isosurfaceExtractor
+{
+public:
+    // Samples (component of the field - offset)*scale
+    isosurfaceExtractor(QSharedPointer<matrix> field, int component, float offset, float scale);
+    isoMesh extract(float iso, QVector3D low, QVector3D high);
+
+private:
+    friend struct isoSampleSlab;
+    friend struct isoExtractSlab;
+
+    qint64 pointIndex(int x, int y, int z) const { return x + size[0]*(y + (qint64)size[1]*z); }
+    int brickIndex(int x, int y, int z) const { return x + bricks[0]*(y + bricks[1]*z); }
+    QVector3D gradient(int x, int y, int z) const;
+
+    QSharedPointer<matrix> field;
+    QVector<int> size;
+    int bricks[3];
+    std::vector<float> quantity;
+    std::vector<float> brickMin, brickMax;
+};
+
+#endif // ISOSURFACE_H
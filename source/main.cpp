@@ -1,18 +1,87 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
 #include <QStyleFactory>
 
 #include "window.h"
+#include "exporter.h"
 
 int main( int argc, char* argv[] )
 {
+    QCommandLineParser parser;
+    parser.setApplicationDescription("3D Viewer of OVF/OMF Micromagnetic Data");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    // General input
+    parser.addPositionalArgument("input", QCoreApplication::translate("Files or Directories", "Input files to open."));
+
+    // Watch files
+    QCommandLineOption watchDirectoryOption(QStringList() << "w" << "watch",
+                QCoreApplication::translate("main", "Watch <directory> and update when new data appears therein."),
+                QCoreApplication::translate("main", "directory"));
+    parser.addOption(watchDirectoryOption);
+
+    // Render images without a window
+    QCommandLineOption exportOption(QStringList() << "e" << "export",
+                QCoreApplication::translate("main", "Render each input file to an image in <directory> offscreen, then exit."),
+                QCoreApplication::translate("main", "directory"));
+    parser.addOption(exportOption);
+    QCommandLineOption sizeOption(QStringList() << "s" << "size",
+                QCoreApplication::translate("main", "Size of exported images, as <width>x<height>."),
+                QCoreApplication::translate("main", "size"), "1920x1080");
+    parser.addOption(sizeOption);
+
+    // Looked at before the application exists, since exporting picks the platform
+    QStringList arguments;
+    for (int i=0; i<argc; i++) {
+        arguments << QString::fromLocal8Bit(argv[i]);
+    }
+    parser.parse(arguments);
+    bool exporting = parser.isSet(exportOption);
+
+#ifdef Q_OS_LINUX
+    // Without a display, EGL on Mesa's surfaceless platform still gives a
+    // desktop OpenGL context, e.g. on llvmpipe. Neither xcb nor offscreen can.
+    if (exporting && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")
+        && qEnvironmentVariableIsEmpty("DISPLAY")
+        && qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY")) {
+        qputenv("QT_QPA_PLATFORM", "eglfs");
+        if (qEnvironmentVariableIsEmpty("QT_QPA_EGLFS_FB")) {
+            qputenv("QT_QPA_EGLFS_FB", "/dev/null");
+        }
+        if (qEnvironmentVariableIsEmpty("EGL_PLATFORM")) {
+            qputenv("EGL_PLATFORM", "surfaceless");
+        }
+    }
+#endif
+
     QApplication app( argc, argv );
 
-    // Parse command line arguments
     QApplication::setApplicationName("Muview");
     QApplication::setApplicationVersion("2.2");
     app.setStyle(QStyleFactory::create("GTK+"));
 
-    Window w( app.arguments() );
+    // Actually parse the arguments, handling help and errors
+    parser.process(app);
+    const QStringList fileargs = parser.positionalArguments();
+
+    // Images only, for batch post-processing. No window is made.
+    if (exporting) {
+        QSize exportSize;
+        QStringList dimensions = parser.value(sizeOption).split('x');
+        if (dimensions.size() == 2) {
+            exportSize = QSize(dimensions[0].toInt(), dimensions[1].toInt());
+        }
+        if (exportSize.isEmpty()) {
+            qWarning() << "Invalid image size" << parser.value(sizeOption);
+            exportSize = QSize(1920, 1080);
+        }
+        Exporter exporter(fileargs, parser.value(exportOption), exportSize);
+        return exporter.exportImages() ? 0 : 1;
+    }
+
+    Window w( fileargs, parser.value(watchDirectoryOption) );
     w.show();
 
     return app.exec();
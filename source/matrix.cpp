@@ -1,36 +1,209 @@
+#include <string.h>
+#include <algorithm>
+#include <QMutex>
+#include <QtAlgorithms>
+#include <QtConcurrent>
 #include "matrix.h"
+#include "OMFEndian.h"
 
-matrix::matrix(int sizeX, int sizeY, int sizeZ)
+// Pages of a matrix mapped from disk read when searching its extrema,
+// spread evenly over the file, so loading never faults in all of it
+static const qint64 mappedExtremaPages = 4096;
+static const qint64 mappedPageBytes = 4096;
+
+// Fraction of vacuum above which only occupied cells are stored
+static const float sparseVacuumFraction = 0.25f;
+
+// Masks of the frames currently loaded, so frames of one geometry share them
+static QList<QWeakPointer<matrixMask> > sharedMasks;
+static QMutex sharedMasksMutex;
+
+matrix::matrix(int sizeX, int sizeY, int sizeZ) :
+    mapped(0),
+    buildingLevel(false),
+    extremaKnown(false)
 {
     sizes << sizeX << sizeY << sizeZ;
-    numElements = sizeX*sizeY*sizeZ;
-    strides << 1 << sizeX << sizeY*sizeX;
-    data = QSharedPointer<QVector<QVector3D> >(new QVector<QVector3D>(numElements));
+    numElements = (qint64)sizeX*sizeY*sizeZ;
+    strides << 1 << sizeX << (qint64)sizeY*sizeX;
+    data = QSharedPointer<std::vector<QVector3D> >(new std::vector<QVector3D>(numElements));
+}
+
+matrix::matrix(int sizeX, int sizeY, int sizeZ, const QString &path, const matrixMapping &layout) :
+    mapped(0),
+    mapping(layout),
+    buildingLevel(false),
+    extremaKnown(false)
+{
+    sizes << sizeX << sizeY << sizeZ;
+    numElements = (qint64)sizeX*sizeY*sizeZ;
+    strides << 1 << sizeX << (qint64)sizeY*sizeX;
+
+    // Values stay in the file; pages are read as cells are visited and
+    // dropped again by the OS under memory pressure
+    file = QSharedPointer<QFile>(new QFile(path));
+    qint64 bytes = numElements*layout.valuedim*layout.valueBytes;
+    if (!file->open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open" << path << "for mapping";
+        return;
+    }
+    if (file->size() < layout.offset + bytes) {
+        qWarning() << "Data in" << path << "is truncated";
+        return;
+    }
+    mapped = file->map(layout.offset, bytes);
+    if (!mapped) {
+        qWarning() << "Could not map" << path << ":" << file->errorString();
+    }
+}
+
+bool matrix::isMapped()
+{
+    return mapped != 0;
+}
+
+void matrix::compact()
+{
+    // Zero vectors are vacuum in patterned geometries; their values and
+    // instances are dropped, leaving a bit per cell to tell them apart.
+    if (mapped || mask) {
+        return;
+    }
+    QSharedPointer<matrixMask> cells(new matrixMask);
+    cells->sizes = sizes;
+    cells->words.assign((numElements + 63)/64, 0);
+    qint64 count = 0;
+    for (qint64 i=0; i<numElements; i++) {
+        if (!(*data)[i].isNull()) {
+            cells->words[i >> 6] |= Q_UINT64_C(1) << (i & 63);
+            count++;
+        }
+    }
+    if (count > (1.0f - sparseVacuumFraction)*numElements) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&sharedMasksMutex);
+        QSharedPointer<matrixMask> shared;
+        for (int i=sharedMasks.size()-1; i>=0; i--) {
+            QSharedPointer<matrixMask> candidate = sharedMasks[i].toStrongRef();
+            if (!candidate) {
+                sharedMasks.removeAt(i);
+            } else if (candidate->sizes == cells->sizes && candidate->words == cells->words) {
+                shared = candidate;
+            }
+        }
+        if (shared) {
+            mask = shared;
+        } else {
+            cells->ranks.resize(cells->words.size());
+            qint64 rank = 0;
+            for (size_t w=0; w<cells->words.size(); w++) {
+                cells->ranks[w] = rank;
+                rank += qPopulationCount(cells->words[w]);
+            }
+            sharedMasks << cells;
+            mask = cells;
+        }
+    }
+
+    QSharedPointer<std::vector<QVector3D> > packed(new std::vector<QVector3D>());
+    packed->reserve(count);
+    for (qint64 i=0; i<numElements; i++) {
+        if (!(*data)[i].isNull()) {
+            packed->push_back((*data)[i]);
+        }
+    }
+    data = packed;
+}
+
+bool matrix::isSparse()
+{
+    return !mask.isNull();
+}
+
+bool matrix::occupied(int x, int y, int z)
+{
+    if (!mask) {
+        return true;
+    }
+    qint64 i = index(x,y,z);
+    return (mask->words[i >> 6] >> (i & 63)) & 1;
+}
+
+QVector3D matrix::sparseValue(qint64 i)
+{
+    quint64 word = mask->words[i >> 6];
+    quint64 bit  = Q_UINT64_C(1) << (i & 63);
+    if (!(word & bit)) {
+        return QVector3D(0,0,0);
+    }
+    return (*data)[mask->ranks[i >> 6] + qPopulationCount(word & (bit - 1))];
 }
 
 void matrix::clear()
 {
-    data->fill(QVector3D(0,0,0));
+    if (data) {
+        std::fill(data->begin(), data->end(), QVector3D(0,0,0));
+    }
 }
 
 void matrix::set(int x, int y, int z, QVector3D vector)
 {
-    data->replace(index(x,y,z), vector);
+    // Only while loading, before compact()
+    Q_ASSERT(!mask && !mapped);
+    (*data)[index(x,y,z)] = vector;
 }
 
-void matrix::set(int ind, QVector3D vector)
+void matrix::set(qint64 ind, QVector3D vector)
 {
-    data->replace(ind, vector);
+    Q_ASSERT(!mask && !mapped);
+    (*data)[ind] = vector;
 }
 
 QVector3D matrix::at(int x, int y, int z)
 {
-    return data->at(index(x,y,z));
+    if (mapped) {
+        return mappedValue(index(x,y,z));
+    }
+    if (mask) {
+        return sparseValue(index(x,y,z));
+    }
+    return (*data)[index(x,y,z)];
 }
 
-QVector3D matrix::get(int i)
+QVector3D matrix::get(qint64 i)
 {
-    return data->at(i);
+    if (mapped) {
+        return mappedValue(i);
+    }
+    if (mask) {
+        return sparseValue(i);
+    }
+    return (*data)[i];
+}
+
+QVector3D matrix::mappedValue(qint64 i)
+{
+    // Decoded straight from the mapping, so it is safe from any thread
+    const uchar *src = mapped + i*mapping.valuedim*mapping.valueBytes;
+    double v[3];
+    for (int c=0; c<mapping.valuedim; c++) {
+        if (mapping.valueBytes == 4) {
+            float f;
+            memcpy(&f, src + c*4, 4);
+            v[c] = mapping.bigEndian ? fromBigEndian(f) : fromLittleEndian(f);
+        } else {
+            double d;
+            memcpy(&d, src + c*8, 8);
+            v[c] = mapping.bigEndian ? fromBigEndian(d) : fromLittleEndian(d);
+        }
+    }
+    if (mapping.valuedim == 1) {
+        v[1] = v[2] = v[0];
+    }
+    return QVector3D(v[0], v[1], v[2]) * mapping.multiplier;
 }
 
 QVector<int> matrix::shape()
@@ -40,18 +213,44 @@ QVector<int> matrix::shape()
 
 void matrix::minmaxScalar(float &min, float &max)
 {
-    float minSearch = (data->at(0)).x();
-    float maxSearch = (data->at(0)).x();
+    searchExtrema(false, min, max);
+}
+
+void matrix::minmaxMagnitude(float &min, float &max)
+{
+    if (!extremaKnown) {
+        searchExtrema(true, minMagnitude, maxMagnitude);
+        extremaKnown = true;
+    }
+    min = minMagnitude;
+    max = maxMagnitude;
+}
+
+void matrix::searchExtrema(bool magnitude, float &min, float &max)
+{
+    // Runs of a page worth of cells for mapped matrices, everything otherwise
+    qint64 run  = numElements;
+    qint64 step = numElements;
+    if (mapped) {
+        run  = qMax((qint64)1, mappedPageBytes/(mapping.valuedim*mapping.valueBytes));
+        step = qMax(run, numElements/mappedExtremaPages);
+    }
+    float minSearch = magnitude ? get(0).length() : get(0).x();
+    float maxSearch = minSearch;
     float val;
 
-    for(int k=0; k<numElements; k++)
+    for(qint64 start=0; start<numElements; start+=step)
     {
-        val = (data->at(0)).x();
-        if (val < minSearch) {
-            minSearch = val;
-        }
-        if (val > maxSearch) {
-            maxSearch = val;
+        qint64 end = qMin(start + run, numElements);
+        for(qint64 k=start; k<end; k++)
+        {
+            val = magnitude ? get(k).length() : get(k).x();
+            if (val < minSearch) {
+                minSearch = val;
+            }
+            if (val > maxSearch) {
+                maxSearch = val;
+            }
         }
     }
 
@@ -59,33 +258,110 @@ void matrix::minmaxScalar(float &min, float &max)
     min = minSearch;
 }
 
-void matrix::minmaxMagnitude(float &min, float &max)
+// One plane of a pyramid level, averaged from the level below
+struct pyramidJob
 {
-    float minSearch = data->at(0).length();
-    float maxSearch = data->at(0).length();
-    float length;
+    matrix *source;
+    matrix *target;
+    int z;
+    float minMag, maxMag;
+};
 
-    for(int k=0; k<numElements; k++)
-    {
-        length = data->at(k).length();
-        if (length < minSearch) {
-            minSearch = length;
+static void averagePlane(pyramidJob &job)
+{
+    // Vacuum does not dilute the average of the cells around it
+    QVector<int> size = job.source->shape();
+    QVector<int> half = job.target->shape();
+    job.minMag = 1.0e30f;
+    job.maxMag = 0.0f;
+    for (int y=0; y<half[1]; y++) {
+        for (int x=0; x<half[0]; x++) {
+            QVector3D sum;
+            int count = 0;
+            for (int c=0; c<8; c++) {
+                int sx = 2*x + (c & 1), sy = 2*y + ((c >> 1) & 1), sz = 2*job.z + ((c >> 2) & 1);
+                if (sx < size[0] && sy < size[1] && sz < size[2] && job.source->occupied(sx, sy, sz)) {
+                    sum += job.source->at(sx, sy, sz);
+                    count++;
+                }
+            }
+            QVector3D mean = count ? sum/count : QVector3D(0,0,0);
+            job.target->set(x, y, job.z, mean);
+            job.minMag = qMin(job.minMag, mean.length());
+            job.maxMag = qMax(job.maxMag, mean.length());
         }
-        if (length > maxSearch) {
-            maxSearch = length;
+    }
+}
+
+QSharedPointer<matrix> matrix::halved()
+{
+    QSharedPointer<matrix> target(new matrix((sizes[0] + 1)/2, (sizes[1] + 1)/2, (sizes[2] + 1)/2));
+    QVector<pyramidJob> planes(target->sizes[2]);
+    for (int z=0; z<planes.size(); z++) {
+        planes[z].source = this;
+        planes[z].target = target.data();
+        planes[z].z      = z;
+    }
+    QtConcurrent::blockingMap(planes, averagePlane);
+
+    target->minMagnitude = planes[0].minMag;
+    target->maxMagnitude = planes[0].maxMag;
+    for (int z=1; z<planes.size(); z++) {
+        target->minMagnitude = qMin(target->minMagnitude, planes[z].minMag);
+        target->maxMagnitude = qMax(target->maxMagnitude, planes[z].maxMag);
+    }
+    target->extremaKnown = true;
+
+    // Coarse masks are shared between frames just like the fine ones
+    if (mask) {
+        target->compact();
+    }
+    return target;
+}
+
+matrix *matrix::level(int n)
+{
+    if (n <= 0) {
+        return this;
+    }
+    if (mapped) {
+        return 0;
+    }
+    // Levels are averaged outside the lock, so callers only wait for one
+    // when it is the level they need, and never merely to check for one
+    QMutexLocker locker(&levelsMutex);
+    while (levels.size() < n) {
+        if (buildingLevel) {
+            levelBuilt.wait(&levelsMutex);
+            continue;
         }
+        buildingLevel = true;
+        matrix *source = levels.isEmpty() ? this : levels.last().data();
+        locker.unlock();
+        QSharedPointer<matrix> next = source->halved();
+        locker.relock();
+        levels << next;
+        buildingLevel = false;
+        levelBuilt.wakeAll();
     }
+    return levels[n-1].data();
+}
 
-    max = maxSearch;
-    min = minSearch;
+bool matrix::hasLevel(int n)
+{
+    if (n <= 0 || mapped) {
+        return true;
+    }
+    QMutexLocker locker(&levelsMutex);
+    return levels.size() >= n;
 }
 
-int matrix::num_elements()
+qint64 matrix::num_elements()
 {
     return numElements;
 }
 
-int matrix::index(int x, int y, int z)
+qint64 matrix::index(int x, int y, int z)
 {
     return x*strides[0] + y*strides[1] + z*strides[2];
 }
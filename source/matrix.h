@@ -1,33 +1,86 @@
 #ifndef MATRIX_H
 #define MATRIX_H
+#include <QFile>
+#include <QMutex>
 #include <QObject>
 #include <QVector>
 #include <QDebug>
 #include <QVector3D>
 #include <QSharedPointer>
+#include <QWaitCondition>
+#include <vector>
+
+// Where and how the values of a binary OVF file are stored,
+// for matrices read from disk on demand
+struct matrixMapping
+{
+    qint64 offset;     // Of the first value in the file
+    int valuedim;
+    int valueBytes;    // 4 or 8
+    bool bigEndian;
+    double multiplier;
+};
+
+// Cells holding material, one bit each in storage order. Frames of the
+// same geometry share one mask.
+struct matrixMask
+{
+    QVector<int> sizes;
+    std::vector<quint64> words;
+    std::vector<qint64> ranks; // Occupied cells before each word
+};
 
 class matrix : public QObject
 {
     Q_OBJECT
 public:
     matrix(int sizeX, int sizeY, int sizeZ);
+    matrix(int sizeX, int sizeY, int sizeZ, const QString &path, const matrixMapping &layout);
+    bool isMapped();
+    void compact();
+    bool isSparse();
+    bool occupied(int x, int y, int z);
     void clear();
     void set(int x, int y, int z, QVector3D vector);
-    void set(int ind, QVector3D vector);
+    void set(qint64 ind, QVector3D vector);
     QVector3D at(int x, int y, int z);
-    QVector3D get(int i);
+    QVector3D get(qint64 i);
     QVector<int> shape();
     void minmaxScalar(float &min, float &max);
     void minmaxMagnitude(float &min, float &max);
-    int num_elements();
+    qint64 num_elements();
+
+    // Averages over blocks of 2^n cells a side, built on first use and
+    // kept with the frame. Level 0 is the matrix itself; mapped matrices
+    // have no other levels.
+    matrix *level(int n);
+    bool hasLevel(int n); // Built already, so level(n) returns at once
 
 private:
-    int index(int x, int y, int z);
+    QSharedPointer<matrix> halved();
+    void searchExtrema(bool magnitude, float &min, float &max);
+    qint64 index(int x, int y, int z);
+    QVector3D mappedValue(qint64 i);
+    QVector3D sparseValue(qint64 i);
     // x, y, z ordering
     QVector<int> sizes;
-    QVector<int> strides;
-    int numElements;
-    QSharedPointer<QVector<QVector3D> > data;
+    QVector<qint64> strides;
+    qint64 numElements;
+    QSharedPointer<std::vector<QVector3D> > data; // Occupied cells only when sparse
+    QSharedPointer<matrixMask> mask;
+
+    // Out of core storage, paged in and out by the OS
+    QSharedPointer<QFile> file;
+    uchar *mapped;
+    matrixMapping mapping;
+
+    // Coarser levels, and the magnitude range once it is known
+    QVector<QSharedPointer<matrix> > levels;
+    QMutex levelsMutex;
+    QWaitCondition levelBuilt;
+    bool buildingLevel; // The next level is being averaged, without the lock
+    bool extremaKnown;
+    float minMagnitude, maxMagnitude;
 };
 
 #endif // MATRIX_H
@@ -114,6 +114,26 @@ QString Preferences::getFormat()
     return ui->imageFormat->currentText();
 }
 
+float Preferences::getUploadTolerance()
+{
+    return (float)ui->uploadTolerance->value();
+}
+
+int Preferences::getTargetFrameRate()
+{
+    return ui->targetFrameRate->value();
+}
+
+float Preferences::getMinRenderScale()
+{
+    return (float)ui->minRenderScale->value();
+}
+
+float Preferences::getMaxRenderScale()
+{
+    return (float)ui->maxRenderScale->value();
+}
+
 QSize Preferences::getImageDimensions()
 {
     if (ui->fixedSize->isChecked()) {
@@ -28,6 +28,10 @@ public:
     QString getVectorOrigin();
     QString getSpriteScale();
     QList<QColor> getCustomColorScale();
+    float getUploadTolerance();
+    int getTargetFrameRate();
+    float getMinRenderScale();
+    float getMaxRenderScale();
     ~Preferences();
 
 private:
@@ -4,8 +4,8 @@ const float PI = 3.1415926535897932384626433832795;
 
 layout(location = 0) in vec4 vertex;
 layout(location = 1) in vec4 vertexNormal;
-layout(location = 2) in vec4 magnetization;
-layout(location = 3) in vec4 translation;
+layout(location = 2) in vec3 magnetization; // snorm16, relative to the largest magnitude
+layout(location = 3) in vec3 translation;   // integer grid coordinates
 
 out vec4 fragVertex;
 out vec4 fragNormal;
@@ -82,7 +82,7 @@ vec3 hsl2rgb(vec3 hsl) {
 
 void main( void )
 {
-    trans = translation;
+    trans = vec4(translation, 0.0);
 
 	// mod_model = model;
     mat4 model = mat4(1.0);
@@ -0,0 +1,104 @@
+#version 330
+
+const float PI = 3.1415926535897932384626433832795;
+
+in vec2 texCoord;
+out vec4 fragColor;
+
+// Field of a single layer, snorm16 relative to the largest magnitude. Holds
+// every film_step-th cell when the film exceeds the texture size limit.
+uniform sampler2D film;
+uniform vec2 film_size;
+uniform float film_step;
+
+// Which quantity to use for coloration
+// 1 = Full Orientation, 2 = In-Plane Angle, 3 = X-component,
+// 4 = Y-Component, 5 = Z-Component
+uniform int display_type;
+
+// Color lookup table
+uniform int use_color_lut;
+uniform vec4 color_lut[256];
+
+uniform float maxmag, thresholdLow, thresholdHigh;
+uniform float xSliceLow, xSliceHigh, ySliceLow, ySliceHigh, zSliceLow, zSliceHigh;
+
+float atan2(in float y, in float x)
+{
+    bool s = (abs(x) > abs(y));
+    return mix(PI/2.0 - atan(x,y), atan(y,x), s);
+}
+
+float hue2rgb(float f1, float f2, float hue) {
+    if (hue < 0.0)
+        hue += 1.0;
+    else if (hue > 1.0)
+        hue -= 1.0;
+    float res;
+    if ((6.0 * hue) < 1.0)
+        res = f1 + (f2 - f1) * 6.0 * hue;
+    else if ((2.0 * hue) < 1.0)
+        res = f2;
+    else if ((3.0 * hue) < 2.0)
+        res = f1 + (f2 - f1) * ((2.0 / 3.0) - hue) * 6.0;
+    else
+        res = f1;
+    return res;
+}
+
+vec3 hsl2rgb(vec3 hsl) {
+    vec3 rgb;
+
+    if (hsl.y == 0.0) {
+        rgb = vec3(hsl.z); // Luminance
+    } else {
+        float f2;
+
+        if (hsl.z < 0.5)
+            f2 = hsl.z * (1.0 + hsl.y);
+        else
+            f2 = hsl.z + hsl.y - hsl.y * hsl.z;
+
+        float f1 = 2.0 * hsl.z - f2;
+
+        rgb.r = hue2rgb(f1, f2, hsl.x + (1.0/3.0));
+        rgb.g = hue2rgb(f1, f2, hsl.x);
+        rgb.b = hue2rgb(f1, f2, hsl.x - (1.0/3.0));
+    }
+    return rgb;
+}
+
+void main( void )
+{
+    // The texel of the cell, not the one under texCoord, which is
+    // off by up to film_step cells when the step doesn't divide the size
+    vec3 cell = vec3(min(floor(texCoord*film_size), film_size - 1.0), 0.0);
+    vec3 magnetization = texelFetch(film, ivec2(cell.xy/film_step), 0).xyz;
+
+    float mag    = length(magnetization);
+    float relmag = mag/maxmag;
+    float phi    = atan2(magnetization.y, magnetization.x);
+
+    // Same thresholding and clipping as the glyph shaders
+    if (mag <= 0.0)
+        discard;
+    if (relmag < thresholdLow - 0.01 || relmag > thresholdHigh + 0.01)
+        discard;
+    if (cell.x < xSliceLow || cell.x > xSliceHigh ||
+        cell.y < ySliceLow || cell.y > ySliceHigh ||
+        cell.z < zSliceLow || cell.z > zSliceHigh)
+        discard;
+
+    // In-plane angle coloring
+    float hue = phi/(2.0*PI);
+    float lum = 0.5;
+
+    if (display_type == 1)
+        lum = 0.5 + 0.5*magnetization.z/mag;
+    if (display_type >= 3) // by component
+        hue = 0.5 + 0.5*magnetization[display_type-3]/mag;
+    if (use_color_lut == 0)
+        fragColor = vec4(hsl2rgb(vec3(hue, 1.0, lum)), 1.0);
+    if (use_color_lut == 1)
+        fragColor = vec4(color_lut[int(255.0*hue)].rgb, 1.0);
+}
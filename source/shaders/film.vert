@@ -0,0 +1,20 @@
+#version 330
+
+layout(location = 0) in vec4 vertex; // Corner of the unit square
+
+out vec2 texCoord;
+
+uniform mat4 view, projection;
+uniform vec3 com;       // Center of mass
+uniform vec2 film_size; // Cells along x and y
+
+void main( void )
+{
+    texCoord = vertex.xy;
+
+    // Cover the cells completely, sitting at the bottom face of the layer
+    vec2 cells = vertex.xy*film_size - 0.5;
+    vec3 pos   = vec3(2.0*(cells - com.xy), 2.0*(0.0 - com.z) - 1.0);
+
+    gl_Position = projection * view * vec4(pos, 1.0);
+}
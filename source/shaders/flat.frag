@@ -0,0 +1,15 @@
+#version 330
+
+in vec4 col;
+out vec4 fragColor;
+
+// Unlit shading for line and point glyphs, colored by standard.vert
+
+void main( void )
+{
+    // Drop thresholded or clipped values as dictated by vertex shader
+    if (col.w > 0.5)
+        discard;
+
+    fragColor = col;
+}
@@ -0,0 +1,120 @@
+#version 330
+
+in vec3 fragEye;
+flat in vec3 glyphBase;
+flat in vec3 glyphAxis;
+flat in vec3 glyphU;
+flat in vec3 glyphV;
+flat in vec4 col;
+out vec4 fragColor;
+
+uniform mat4 projection;
+uniform float scale;
+uniform float ambient;
+uniform struct Light {
+   vec4 position;
+   vec4 intensities; //a.k.a the color of the light
+} light;
+
+// Glyph profile along its axis, before scaling. A cone has
+// glyph_shaft == 0 and glyph_neck == glyph_tail.
+uniform float glyph_tail, glyph_neck, glyph_head, glyph_radius, glyph_shaft;
+
+const float NO_HIT = 1.0e30;
+
+// Closest intersection with a disc of the given radius in the plane z = h
+// facing -z. Returns the ray parameter, or NO_HIT.
+float hitDisc(vec3 o, vec3 d, float h, float r)
+{
+    if (d.z <= 0.0)
+        return NO_HIT;
+    float t = (h - o.z)/d.z;
+    vec2 p = o.xy + t*d.xy;
+    return (t > 0.0 && dot(p, p) <= r*r) ? t : NO_HIT;
+}
+
+void main( void )
+{
+    // Drop thresholded or clipped values as dictated by vertex shader
+    if (col.w > 0.5)
+        discard;
+
+    // Ray from the eye through this fragment, in the glyph frame with
+    // lengths divided by the subsampling scale
+    vec3 rayEye = normalize(fragEye);
+    vec3 rel = -glyphBase/scale;
+    vec3 o = vec3(dot(rel, glyphU), dot(rel, glyphV), dot(rel, glyphAxis));
+    vec3 d = vec3(dot(rayEye, glyphU), dot(rayEye, glyphV), dot(rayEye, glyphAxis));
+
+    float tHit = NO_HIT;
+    vec3 normal = vec3(0.0);
+
+    // Cone from the neck (radius glyph_radius) up to the apex at the head
+    float k  = glyph_radius/(glyph_head - glyph_neck);
+    float k2 = k*k;
+    float hz = glyph_head - o.z;
+    float a = d.x*d.x + d.y*d.y - k2*d.z*d.z;
+    float b = 2.0*(o.x*d.x + o.y*d.y + k2*hz*d.z);
+    float c = o.x*o.x + o.y*o.y - k2*hz*hz;
+    float disc = b*b - 4.0*a*c;
+    if (disc >= 0.0 && abs(a) > 1.0e-8) {
+        float sq = sqrt(disc);
+        float t0 = (-b - sq)/(2.0*a);
+        float t1 = (-b + sq)/(2.0*a);
+        float ts[2] = float[2](min(t0, t1), max(t0, t1));
+        for (int i = 0; i < 2; i++) {
+            vec3 p = o + ts[i]*d;
+            if (ts[i] > 0.0 && ts[i] < tHit && p.z >= glyph_neck && p.z <= glyph_head) {
+                tHit = ts[i];
+                normal = normalize(vec3(p.xy, k2*(glyph_head - p.z)));
+                break;
+            }
+        }
+    }
+
+    // Underside of the cone
+    float t = hitDisc(o, d, glyph_neck, glyph_radius);
+    if (t < tHit) {
+        tHit = t;
+        normal = vec3(0.0, 0.0, -1.0);
+    }
+
+    // Shaft, a cylinder from the tail to the neck, and its end cap
+    if (glyph_shaft > 0.0) {
+        a = d.x*d.x + d.y*d.y;
+        b = 2.0*(o.x*d.x + o.y*d.y);
+        c = o.x*o.x + o.y*o.y - glyph_shaft*glyph_shaft;
+        disc = b*b - 4.0*a*c;
+        if (disc >= 0.0 && a > 1.0e-8) {
+            t = (-b - sqrt(disc))/(2.0*a);
+            vec3 p = o + t*d;
+            if (t > 0.0 && t < tHit && p.z >= glyph_tail && p.z <= glyph_neck) {
+                tHit = t;
+                normal = vec3(p.xy/glyph_shaft, 0.0);
+            }
+        }
+        t = hitDisc(o, d, glyph_tail, glyph_shaft);
+        if (t < tHit) {
+            tHit = t;
+            normal = vec3(0.0, 0.0, -1.0);
+        }
+    }
+
+    if (tHit >= NO_HIT)
+        discard;
+
+    // Back to eye coordinates
+    vec3 hitEye = (scale*tHit)*rayEye;
+    vec3 nrm = normalize(normal.x*glyphU + normal.y*glyphV + normal.z*glyphAxis);
+
+    vec4 clip = projection * vec4(hitEye, 1.0);
+    gl_FragDepth = 0.5*(clip.z/clip.w) + 0.5;
+
+    // Same lighting as standard.frag, relative to the glyph origin
+    vec3 fragPosition = hitEye - glyphBase;
+    vec3 surfaceToLight = vec3(light.position) - fragPosition;
+    float brightness = dot(nrm, surfaceToLight) / length(surfaceToLight);
+    brightness = clamp(brightness, 0, 1);
+
+    fragColor = (ambient + brightness * light.intensities) * col;
+}
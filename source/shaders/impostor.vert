@@ -0,0 +1,147 @@
+#version 330
+
+const float PI = 3.1415926535897932384626433832795;
+
+layout(location = 0) in vec4 vertex;
+layout(location = 2) in vec3 magnetization; // snorm16, relative to the largest magnitude
+layout(location = 3) in vec3 translation;   // integer grid coordinates
+
+out vec3 fragEye;          // Position on the billboard in eye coordinates
+flat out vec3 glyphBase;   // Glyph origin in eye coordinates
+flat out vec3 glyphAxis;   // Glyph frame in eye coordinates, axis along m
+flat out vec3 glyphU;
+flat out vec3 glyphV;
+flat out vec4 col;
+
+float mag, relmag, phi;
+
+// Which quantity to use for coloration
+// 1 = Full Orientation, 2 = In-Plane Angle, 3 = X-component,
+// 4 = Y-Component, 5 = Z-Component
+uniform int display_type;
+
+// Color lookup table
+uniform int use_color_lut;
+uniform vec4 color_lut[256];
+
+uniform float scale;
+
+uniform mat4 view, projection;
+uniform vec3 com; // Center of mass
+uniform float maxmag, thresholdLow, thresholdHigh;
+uniform float xSliceLow, xSliceHigh, ySliceLow, ySliceHigh, zSliceLow, zSliceHigh;
+
+// Glyph profile along its axis, before scaling
+uniform float glyph_tail, glyph_neck, glyph_head, glyph_radius;
+
+float atan2(in float y, in float x)
+{
+    bool s = (abs(x) > abs(y));
+    return mix(PI/2.0 - atan(x,y), atan(y,x), s);
+}
+
+float hue2rgb(float f1, float f2, float hue) {
+    if (hue < 0.0)
+        hue += 1.0;
+    else if (hue > 1.0)
+        hue -= 1.0;
+    float res;
+    if ((6.0 * hue) < 1.0)
+        res = f1 + (f2 - f1) * 6.0 * hue;
+    else if ((2.0 * hue) < 1.0)
+        res = f2;
+    else if ((3.0 * hue) < 2.0)
+        res = f1 + (f2 - f1) * ((2.0 / 3.0) - hue) * 6.0;
+    else
+        res = f1;
+    return res;
+}
+
+vec3 hsl2rgb(vec3 hsl) {
+    vec3 rgb;
+
+    if (hsl.y == 0.0) {
+        rgb = vec3(hsl.z); // Luminance
+    } else {
+        float f2;
+
+        if (hsl.z < 0.5)
+            f2 = hsl.z * (1.0 + hsl.y);
+        else
+            f2 = hsl.z + hsl.y - hsl.y * hsl.z;
+
+        float f1 = 2.0 * hsl.z - f2;
+
+        rgb.r = hue2rgb(f1, f2, hsl.x + (1.0/3.0));
+        rgb.g = hue2rgb(f1, f2, hsl.x);
+        rgb.b = hue2rgb(f1, f2, hsl.x - (1.0/3.0));
+    }
+    return rgb;
+}
+
+void main( void )
+{
+    mag    = length(magnetization);
+    relmag = mag/maxmag;
+    phi    = atan2(magnetization.y, magnetization.x);
+
+    // Orthonormal frame around the glyph axis, in eye coordinates
+    mat3 rot  = mat3(view);
+    vec3 dir  = (mag > 0.0) ? magnetization/mag : vec3(0.0, 0.0, 1.0);
+    glyphAxis = normalize(rot * dir);
+    vec3 helper = (abs(glyphAxis.x) < 0.9) ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0);
+    glyphU = normalize(cross(helper, glyphAxis));
+    glyphV = cross(glyphAxis, glyphU);
+
+    glyphBase = vec3(view * vec4(2.0*(translation-com), 1.0));
+
+    // Screen aligned quad covering the bounding sphere of the glyph. The
+    // margin absorbs the perspective stretch of off-axis spheres.
+    float halfLength = 0.5*(glyph_head - glyph_tail);
+    float radius = scale*sqrt(halfLength*halfLength + glyph_radius*glyph_radius);
+    vec3 center  = glyphBase + scale*(glyph_tail + halfLength)*glyphAxis;
+    fragEye = center + 1.2*radius*vec3(vertex.xy, 0.0);
+
+    // In-plane angle coloring
+    float hue = phi/(2.0*PI);
+    float lum = 0.5;
+
+    if (display_type == 1)
+        lum = 0.5 + 0.5*magnetization.z/mag;
+    if (display_type >= 3) // by component
+        hue = 0.5 + 0.5*magnetization[display_type-3]/mag;
+    if (use_color_lut == 0)
+        col = vec4(hsl2rgb(vec3(hue, 1.0, lum)), 0.0);
+    if (use_color_lut == 1)
+        col = color_lut[int(255.0*hue)];
+
+    // Vacuum cells have no direction to draw
+    if (mag <= 0.0)
+        col.w = 1.0;
+
+    // Discarded because of thresholding
+    if (relmag < thresholdLow - 0.01)
+        col.w = 1.0;
+    if (relmag > thresholdHigh + 0.01)
+        col.w = 1.0;
+
+    // Discarded because of clipping
+    if (translation.x < xSliceLow)
+        col.w = 1.0;
+    if (translation.x > xSliceHigh)
+        col.w = 1.0;
+    if (translation.y < ySliceLow)
+        col.w = 1.0;
+    if (translation.y > ySliceHigh)
+        col.w = 1.0;
+    if (translation.z < zSliceLow)
+        col.w = 1.0;
+    if (translation.z > zSliceHigh)
+        col.w = 1.0;
+
+    // Collapse discarded glyphs so they cost no fragments at all
+    if (col.w > 0.5)
+        fragEye = center;
+
+    gl_Position = projection * vec4(fragEye, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330
+
+in vec4 col;
+in vec3 fragPosition;
+in vec3 nrm;
+out vec4 fragColor;
+
+uniform float ambient;
+uniform struct Light {
+   vec4 position;
+   vec4 intensities; //a.k.a the color of the light
+} light;
+
+void main( void )
+{
+    // Isosurfaces have no outside, so light both sides alike
+    vec3 surfaceToLight = vec3(light.position) - fragPosition;
+    float brightness = abs(dot(nrm, surfaceToLight)) / length(surfaceToLight);
+    brightness = clamp(brightness, 0, 1);
+
+    fragColor = (ambient + brightness * light.intensities) * col;
+}
@@ -0,0 +1,94 @@
+#version 330
+
+const float PI = 3.1415926535897932384626433832795;
+
+layout(location = 0) in vec3 vertex;        // Point on the surface, in grid coordinates
+layout(location = 1) in vec3 vertexNormal;
+layout(location = 2) in vec3 magnetization; // snorm16, relative to the largest magnitude
+
+out vec4 col;
+out vec3 fragPosition;
+out vec3 nrm;
+
+// Which quantity to use for coloration
+// 1 = Full Orientation, 2 = In-Plane Angle, 3 = X-component,
+// 4 = Y-Component, 5 = Z-Component
+uniform int display_type;
+
+// Color lookup table
+uniform int use_color_lut;
+uniform vec4 color_lut[256];
+
+uniform mat4 view, projection;
+uniform vec3 com; // Center of mass
+
+float atan2(in float y, in float x)
+{
+    bool s = (abs(x) > abs(y));
+    return mix(PI/2.0 - atan(x,y), atan(y,x), s);
+}
+
+float hue2rgb(float f1, float f2, float hue) {
+    if (hue < 0.0)
+        hue += 1.0;
+    else if (hue > 1.0)
+        hue -= 1.0;
+    float res;
+    if ((6.0 * hue) < 1.0)
+        res = f1 + (f2 - f1) * 6.0 * hue;
+    else if ((2.0 * hue) < 1.0)
+        res = f2;
+    else if ((3.0 * hue) < 2.0)
+        res = f1 + (f2 - f1) * ((2.0 / 3.0) - hue) * 6.0;
+    else
+        res = f1;
+    return res;
+}
+
+vec3 hsl2rgb(vec3 hsl) {
+    vec3 rgb;
+    
+    if (hsl.y == 0.0) {
+        rgb = vec3(hsl.z); // Luminance
+    } else {
+        float f2;
+        
+        if (hsl.z < 0.5)
+            f2 = hsl.z * (1.0 + hsl.y);
+        else
+            f2 = hsl.z + hsl.y - hsl.y * hsl.z;
+            
+        float f1 = 2.0 * hsl.z - f2;
+        
+        rgb.r = hue2rgb(f1, f2, hsl.x + (1.0/3.0));
+        rgb.g = hue2rgb(f1, f2, hsl.x);
+        rgb.b = hue2rgb(f1, f2, hsl.x - (1.0/3.0));
+    }   
+    return rgb;
+}
+
+void main( void )
+{
+    float mag = length(magnetization);
+    float phi = atan2(magnetization.y, magnetization.x);
+
+    // Same coloring as the glyphs
+    float hue = phi/(2.0*PI);
+    float lum = 0.5;
+
+    if (display_type == 1)
+        lum = 0.5 + 0.5*magnetization.z/mag;
+    if (display_type >= 3) // by component
+        hue = 0.5 + 0.5*magnetization[display_type-3]/mag;
+    if (use_color_lut == 0)
+        col = vec4(hsl2rgb(vec3(hue, 1.0, lum)), 0.0);
+    if (use_color_lut == 1)
+        col = color_lut[int(255.0*hue)];
+
+    // Lit in view space, view being a rigid transform
+    vec4 position = view * vec4(2.0*(vertex - com), 1.0);
+    fragPosition  = vec3(position);
+    nrm           = normalize(mat3(view) * vertexNormal);
+
+    gl_Position = projection * position;
+}
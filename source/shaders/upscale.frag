@@ -0,0 +1,13 @@
+#version 330
+
+in vec2 texCoord;
+out vec4 fragColor;
+
+// Stretches the reduced resolution scene over the widget
+
+uniform sampler2D scene;
+
+void main( void )
+{
+    fragColor = texture(scene, texCoord);
+}
@@ -0,0 +1,12 @@
+#version 330
+
+out vec2 texCoord;
+
+// Full-screen triangle from the vertex index, no buffers needed
+
+void main( void )
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    texCoord    = corner;
+    gl_Position = vec4(2.0*corner - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,96 @@
+#version 330
+
+in vec3 worldPosition;
+out vec4 fragColor;
+
+// Scalar field, normalized to [0,1] between the smallest and largest value
+uniform sampler3D volume;
+uniform vec3 volume_size; // Cells spanned by the texture along x, y and z
+
+uniform vec3 com;               // Center of mass
+uniform vec3 eye;               // Camera position, in world coordinates
+uniform vec3 box_low, box_high; // Ray bounds, in world coordinates
+uniform float density;          // Opacity per cell
+
+// Color lookup table
+uniform int use_color_lut;
+uniform vec4 color_lut[256];
+
+uniform float thresholdLow, thresholdHigh;
+
+float hue2rgb(float f1, float f2, float hue) {
+    if (hue < 0.0)
+        hue += 1.0;
+    else if (hue > 1.0)
+        hue -= 1.0;
+    float res;
+    if ((6.0 * hue) < 1.0)
+        res = f1 + (f2 - f1) * 6.0 * hue;
+    else if ((2.0 * hue) < 1.0)
+        res = f2;
+    else if ((3.0 * hue) < 2.0)
+        res = f1 + (f2 - f1) * ((2.0 / 3.0) - hue) * 6.0;
+    else
+        res = f1;
+    return res;
+}
+
+vec3 hsl2rgb(vec3 hsl) {
+    vec3 rgb;
+
+    if (hsl.y == 0.0) {
+        rgb = vec3(hsl.z); // Luminance
+    } else {
+        float f2;
+
+        if (hsl.z < 0.5)
+            f2 = hsl.z * (1.0 + hsl.y);
+        else
+            f2 = hsl.z + hsl.y - hsl.y * hsl.z;
+
+        float f1 = 2.0 * hsl.z - f2;
+
+        rgb.r = hue2rgb(f1, f2, hsl.x + (1.0/3.0));
+        rgb.g = hue2rgb(f1, f2, hsl.x);
+        rgb.b = hue2rgb(f1, f2, hsl.x - (1.0/3.0));
+    }
+    return rgb;
+}
+
+void main( void )
+{
+    // Where the ray through this pixel enters and leaves the box
+    vec3 dir   = normalize(worldPosition - eye);
+    vec3 t0    = (box_low  - eye)/dir;
+    vec3 t1    = (box_high - eye)/dir;
+    vec3 tmin  = min(t0, t1);
+    vec3 tmax  = max(t0, t1);
+    float near = max(max(tmin.x, tmin.y), max(tmin.z, 0.0));
+    float far  = min(min(tmax.x, tmax.y), tmax.z);
+
+    // Half a cell per step, cells being two units wide
+    const float stepSize = 1.0;
+    float alpha = 1.0 - exp(-0.5*stepSize*density);
+
+    // Front to back compositing, premultiplied
+    vec4 acc = vec4(0.0);
+    for (float t = near + 0.5*stepSize; t < far && acc.a < 0.98; t += stepSize) {
+        vec3 cell   = 0.5*(eye + t*dir) + com;
+        float value = texture(volume, (cell + 0.5)/volume_size).r;
+        if (value < thresholdLow || value > thresholdHigh)
+            continue;
+
+        vec3 col;
+        if (use_color_lut == 1)
+            col = color_lut[int(255.0*value)].rgb;
+        else
+            col = hsl2rgb(vec3(value, 1.0, 0.5));
+
+        acc.rgb += (1.0 - acc.a)*alpha*col;
+        acc.a   += (1.0 - acc.a)*alpha;
+    }
+
+    if (acc.a <= 0.0)
+        discard;
+    fragColor = acc;
+}
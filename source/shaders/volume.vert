@@ -0,0 +1,14 @@
+#version 330
+
+layout(location = 0) in vec4 vertex; // Corner of the [-1,1] cube
+
+out vec3 worldPosition;
+
+uniform mat4 view, projection;
+uniform vec3 box_low, box_high; // Ray bounds, in world coordinates
+
+void main( void )
+{
+    worldPosition = mix(box_low, box_high, 0.5*(vertex.xyz + 1.0));
+    gl_Position   = projection * view * vec4(worldPosition, 1.0);
+}
@@ -1,4 +1,4 @@
-QT          += core gui widgets opengl
+QT          += core gui widgets opengl concurrent
 TEMPLATE     = app
 TARGET       = ../muview
 INCLUDEPATH += $$top_srcdir
@@ -15,6 +15,9 @@ linux {
     message("    will install muview (binary) to /usr/local/bin")
     target.path = /usr/local/bin
 
+    # Headless contexts for exporting, see glcontext.cpp
+    LIBS += -lEGL
+
     UNAME = $$system(uname -a)
 
     contains(UNAME, .*Ubuntu): UBUNTU = 1
@@ -76,8 +79,16 @@ SOURCES +=  \
     main.cpp \
     window.cpp \
     glwidget.cpp \
-    glwidget_input.cpp \
-    glwidget_assets.cpp \
+    glrenderer.cpp \
+    glrenderer_input.cpp \
+    glrenderer_assets.cpp \
+    glrenderer_quality.cpp \
+    glrenderer_offscreen.cpp \
+    glcontext.cpp \
+    exporter.cpp \
+    fieldlines.cpp \
+    isosurface.cpp \
+    instancebuilder.cpp \
     qxtspanslider.cpp \
     preferences.cpp \
     aboutdialog.cpp \
@@ -87,6 +98,12 @@ SOURCES +=  \
 HEADERS  += \
     matrix.h \
     glwidget.h \
+    glrenderer.h \
+    glcontext.h \
+    exporter.h \
+    fieldlines.h \
+    isosurface.h \
+    instancebuilder.h \
     qxtspanslider.h \
     qxtspanslider_p.h \
     preferences.h \
@@ -105,6 +122,18 @@ OTHER_FILES +=  \
     shaders/cube.vert \
     shaders/standard.frag \
     shaders/standard.vert \
+    shaders/fieldline.vert \
+    shaders/film.frag \
+    shaders/film.vert \
+    shaders/flat.frag \
+    shaders/impostor.frag \
+    shaders/impostor.vert \
+    shaders/iso.frag \
+    shaders/iso.vert \
+    shaders/volume.frag \
+    shaders/volume.vert \
+    shaders/upscale.frag \
+    shaders/upscale.vert \
     resources/splash.png \
     resources/splash2.png \
     resources/muview.desktop \
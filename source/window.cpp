@@ -10,9 +10,9 @@
 #include <QTimer>
 #include <QMap>
 #include <QColorDialog>
+#include <QLabel>
 #include <QGLFormat>
 #include <QSharedPointer>
-#include <QCommandLineParser>
 
 #include "glwidget.h"
 #include "window.h"
@@ -25,29 +25,10 @@
 
 struct OMFImport;
 
-Window::Window(QStringList arguments) :
+Window::Window(QStringList fileargs, QString watchDir) :
     QMainWindow(NULL),
     ui(new Ui::Window)
 {
-    QCommandLineParser parser;
-    parser.setApplicationDescription("3D Viewer of OVF/OMF Micromagnetic Data");
-    parser.addHelpOption();
-    parser.addVersionOption();
-
-    // General input
-    parser.addPositionalArgument("input", QCoreApplication::translate("Files or Directories", "Input files to open."));
-
-    // Watch files
-    QCommandLineOption watchDirectoryOption(QStringList() << "w" << "watch",
-                QCoreApplication::translate("main", "Watch <directory> and update when new data appears therein."),
-                QCoreApplication::translate("main", "directory"));
-    parser.addOption(watchDirectoryOption);
-
-    // Actually parse the arguments
-    parser.process(arguments);
-    const QStringList fileargs = parser.positionalArguments();
-    QString watchDir = parser.value(watchDirectoryOption);
-
     // Initialize GUI
     ui->setupUi(this);
 
@@ -72,6 +53,7 @@ Window::Window(QStringList arguments) :
 
     // File defaults
     lastSavedLocation = QDir::home();
+    sequenceFrame = 0;
     lastOpenedLocation = QDir::home();
     watcher = new QFileSystemWatcher;
 
@@ -92,24 +74,36 @@ Window::Window(QStringList arguments) :
     initSpanSlider(ui->ySpanSlider);
     initSpanSlider(ui->zSpanSlider);
     initSpanSlider(ui->thresholdSlider);
+    ui->isoSlider->setRange(0, 100 * 16);
+    ui->isoSlider->setSingleStep(16);
+    ui->isoSlider->setPageStep(15 * 16);
+    ui->isoSlider->setTickInterval(25 * 16);
+    ui->isoSlider->setTickPosition(QSlider::TicksRight);
+    ui->isoSlider->setValue(50 * 16);
 
     // Rotation
-    connect(ui->xSlider,  SIGNAL(valueChanged(int)),     viewport, SLOT(setXRotation(int)));
-    connect(viewport, SIGNAL(xRotationChanged(int)), ui->xSlider, SLOT(setValue(int)));
-    connect(ui->ySlider,  SIGNAL(valueChanged(int)),     viewport, SLOT(setYRotation(int)));
-    connect(viewport, SIGNAL(yRotationChanged(int)), ui->ySlider, SLOT(setValue(int)));
-    connect(ui->zSlider,  SIGNAL(valueChanged(int)),     viewport, SLOT(setZRotation(int)));
-    connect(viewport, SIGNAL(zRotationChanged(int)), ui->zSlider, SLOT(setValue(int)));
+    connect(ui->xSlider,  SIGNAL(valueChanged(int)),     viewport->renderer(), SLOT(setXRotation(int)));
+    connect(viewport->renderer(), SIGNAL(xRotationChanged(int)), ui->xSlider, SLOT(setValue(int)));
+    connect(ui->ySlider,  SIGNAL(valueChanged(int)),     viewport->renderer(), SLOT(setYRotation(int)));
+    connect(viewport->renderer(), SIGNAL(yRotationChanged(int)), ui->ySlider, SLOT(setValue(int)));
+    connect(ui->zSlider,  SIGNAL(valueChanged(int)),     viewport->renderer(), SLOT(setZRotation(int)));
+    connect(viewport->renderer(), SIGNAL(zRotationChanged(int)), ui->zSlider, SLOT(setValue(int)));
 
     // Slicing
-    connect(ui->xSpanSlider, SIGNAL(lowerValueChanged(int)), viewport, SLOT(setXSliceLow(int)));
-    connect(ui->xSpanSlider, SIGNAL(upperValueChanged(int)), viewport, SLOT(setXSliceHigh(int)));
-    connect(ui->ySpanSlider, SIGNAL(lowerValueChanged(int)), viewport, SLOT(setYSliceLow(int)));
-    connect(ui->ySpanSlider, SIGNAL(upperValueChanged(int)), viewport, SLOT(setYSliceHigh(int)));
-    connect(ui->zSpanSlider, SIGNAL(lowerValueChanged(int)), viewport, SLOT(setZSliceLow(int)));
-    connect(ui->zSpanSlider, SIGNAL(upperValueChanged(int)), viewport, SLOT(setZSliceHigh(int)));
-    connect(ui->thresholdSlider, SIGNAL(lowerValueChanged(int)), viewport, SLOT(setThresholdLow(int)));
-    connect(ui->thresholdSlider, SIGNAL(upperValueChanged(int)), viewport, SLOT(setThresholdHigh(int)));
+    connect(ui->xSpanSlider, SIGNAL(lowerValueChanged(int)), viewport->renderer(), SLOT(setXSliceLow(int)));
+    connect(ui->xSpanSlider, SIGNAL(upperValueChanged(int)), viewport->renderer(), SLOT(setXSliceHigh(int)));
+    connect(ui->ySpanSlider, SIGNAL(lowerValueChanged(int)), viewport->renderer(), SLOT(setYSliceLow(int)));
+    connect(ui->ySpanSlider, SIGNAL(upperValueChanged(int)), viewport->renderer(), SLOT(setYSliceHigh(int)));
+    connect(ui->zSpanSlider, SIGNAL(lowerValueChanged(int)), viewport->renderer(), SLOT(setZSliceLow(int)));
+    connect(ui->zSpanSlider, SIGNAL(upperValueChanged(int)), viewport->renderer(), SLOT(setZSliceHigh(int)));
+    connect(ui->thresholdSlider, SIGNAL(lowerValueChanged(int)), viewport->renderer(), SLOT(setThresholdLow(int)));
+    connect(ui->thresholdSlider, SIGNAL(upperValueChanged(int)), viewport->renderer(), SLOT(setThresholdHigh(int)));
+    connect(ui->isoSlider, SIGNAL(valueChanged(int)), viewport->renderer(), SLOT(setIsoValue(int)));
+
+    uploadLabel = new QLabel(this);
+    ui->statusbar->addPermanentWidget(uploadLabel);
+    connect(viewport->renderer(), SIGNAL(instancesUploaded(float)), this, SLOT(showUploaded(float)));
+    connect(viewport->renderer(), SIGNAL(imageRendered(QImage)), this, SLOT(imageRendered(QImage)));
 
     // Animation
     ui->animSlider->setEnabled(false);
@@ -128,16 +122,47 @@ Window::Window(QStringList arguments) :
     connect(ui->actionCubes, SIGNAL(triggered()), this, SLOT(toggleDisplay()));
     connect(ui->actionCones, SIGNAL(triggered()), this, SLOT(toggleDisplay()));
     connect(ui->actionVectors, SIGNAL(triggered()), this, SLOT(toggleDisplay()));
+    connect(ui->actionImpostors, SIGNAL(triggered()), this, SLOT(toggleDisplay()));
+    connect(ui->actionLines, SIGNAL(triggered()), this, SLOT(toggleDisplay()));
+    connect(ui->actionPoints, SIGNAL(triggered()), this, SLOT(toggleDisplay()));
+
+    connect(ui->actionFilm, SIGNAL(toggled(bool)), viewport->renderer(), SLOT(setFilmMode(bool)));
+    connect(ui->actionSurface, SIGNAL(toggled(bool)), viewport->renderer(), SLOT(setSurfaceMode(bool)));
+    connect(ui->actionGreedy, SIGNAL(toggled(bool)), viewport->renderer(), SLOT(setGreedyMode(bool)));
+    connect(ui->actionVolume, SIGNAL(toggled(bool)), viewport->renderer(), SLOT(setVolumeMode(bool)));
 
-    connect(ui->actionIncreaseSubsampling, SIGNAL(triggered()), viewport, SLOT(increaseSubsampling()));
-    connect(ui->actionDecreaseSubsampling, SIGNAL(triggered()), viewport, SLOT(decreaseSubsampling()));
+    connect(ui->actionIncreaseSubsampling, SIGNAL(triggered()), viewport->renderer(), SLOT(increaseSubsampling()));
+    connect(ui->actionDecreaseSubsampling, SIGNAL(triggered()), viewport->renderer(), SLOT(decreaseSubsampling()));
 
     displayType = new QActionGroup(this);
     displayType->addAction(ui->actionCubes);
     displayType->addAction(ui->actionCones);
     displayType->addAction(ui->actionVectors);
+    displayType->addAction(ui->actionImpostors);
+    displayType->addAction(ui->actionLines);
+    displayType->addAction(ui->actionPoints);
     ui->actionCubes->setChecked(true);
 
+    connect(ui->actionFieldLinesOff, SIGNAL(triggered()), this, SLOT(toggleFieldLines()));
+    connect(ui->actionFieldLinesGrid, SIGNAL(triggered()), this, SLOT(toggleFieldLines()));
+    connect(ui->actionFieldLinesPlane, SIGNAL(triggered()), this, SLOT(toggleFieldLines()));
+    fieldLineSeeds = new QActionGroup(this);
+    fieldLineSeeds->addAction(ui->actionFieldLinesOff);
+    fieldLineSeeds->addAction(ui->actionFieldLinesGrid);
+    fieldLineSeeds->addAction(ui->actionFieldLinesPlane);
+    ui->actionFieldLinesOff->setChecked(true);
+
+    connect(ui->actionIsoOff, SIGNAL(triggered()), this, SLOT(toggleIsosurface()));
+    connect(ui->actionIsoX, SIGNAL(triggered()), this, SLOT(toggleIsosurface()));
+    connect(ui->actionIsoY, SIGNAL(triggered()), this, SLOT(toggleIsosurface()));
+    connect(ui->actionIsoZ, SIGNAL(triggered()), this, SLOT(toggleIsosurface()));
+    isoComponent = new QActionGroup(this);
+    isoComponent->addAction(ui->actionIsoOff);
+    isoComponent->addAction(ui->actionIsoX);
+    isoComponent->addAction(ui->actionIsoY);
+    isoComponent->addAction(ui->actionIsoZ);
+    ui->actionIsoOff->setChecked(true);
+
     signalMapper = new QSignalMapper(this);
     signalMapper->setMapping (ui->actionFollow, "") ;
     connect (signalMapper, SIGNAL(mapped(QString)), this, SLOT(watch(QString))) ;
@@ -267,6 +292,14 @@ void Window::updatePrefs() {
     viewport->setColorScale(prefs->getColorScale());
     viewport->setSpriteScale(prefs->getSpriteScale());
     viewport->setCustomColorScale(prefs->getCustomColorScale());
+    viewport->setUploadTolerance(prefs->getUploadTolerance());
+    viewport->setTargetFrameRate(prefs->getTargetFrameRate());
+    viewport->setRenderScaleRange(prefs->getMinRenderScale(), prefs->getMaxRenderScale());
+}
+
+void Window::showUploaded(float percent)
+{
+    uploadLabel->setText(QString("Uploaded %1%").arg(percent, 0, 'f', 1));
 }
 
 void Window::openSettings()
@@ -485,15 +518,42 @@ void Window::saveImageFile(QString name)
 {
     if (name != "") {
         lastSavedLocation = QDir(name);
-        QImage screen = viewport->grabFrameBuffer();
-        screen.save(name, 0, 90); //format was (prefs->getFormat()).toStdString().c_str()
+        imageTargets << name;
+        viewport->requestImage(imageSize());
     }
 }
 
 void Window::copyImage()
 {
-    QImage screen = viewport->grabFrameBuffer();
-    clipboard->setImage(screen);
+    imageTargets << "";
+    viewport->requestImage(imageSize());
+}
+
+void Window::imageRendered(QImage image)
+{
+    // Requests are answered in order, so the first target is this image's
+    if (imageTargets.isEmpty()) {
+        return;
+    }
+    QString name = imageTargets.takeFirst();
+    if (name == "") {
+        clipboard->setImage(image);
+    } else if (image.isNull() || !image.save(name, 0, 90)) { //format was (prefs->getFormat()).toStdString().c_str()
+        qWarning() << "Could not save" << name;
+    }
+    if (sequenceDir != "" && name == sequencePath) {
+        sequenceFrame++;
+        saveSequenceFrame();
+    }
+}
+
+QSize Window::imageSize()
+{
+    // Rendered offscreen, so not limited to the size of the viewport
+    if (prefs->getImageDimensions() == QSize(-1,-1)) {
+        return viewport->size();
+    }
+    return prefs->getImageDimensions();
 }
 
 void Window::saveImage()
@@ -516,26 +576,29 @@ void Window::saveImageSequence()
         QFileDialog::ShowDirsOnly
         | QFileDialog::DontResolveSymlinks);
 
-    if (dir != "")
+    // One frame at a time, the next once the last is saved, see imageRendered
+    if (dir != "" && sequenceDir == "")
     {
-        connect(viewport, SIGNAL(doneRenderingFrame(QString)), this, SLOT(saveImageFile(QString)));
-
         lastSavedLocation = QDir(dir);
-        QImage screen;
-        QString number;
-        QString format = (prefs->getFormat()).toLower();
-        QString outpath;
-        for (int i=0; i<filenames.length(); i++) {
-            number = QString("%1").arg(i, 6, 'd', 0, QChar('0'));
-            ui->animSlider->setValue(i);
-            outpath = dir+"/muviewSequence"+number+"."+format;
-            ui->statusbar->showMessage("Saving file "+outpath);
-            update();
-            viewport->renderFrame(outpath);
-        }
+        sequenceDir = dir;
+        sequenceFrame = 0;
+        saveSequenceFrame();
+    }
+}
 
-        disconnect(viewport, SIGNAL(doneRenderingFrame(QString)), this, SLOT(saveImageFile(QString)));
+void Window::saveSequenceFrame()
+{
+    if (sequenceFrame >= filenames.length()) {
+        ui->statusbar->showMessage("Saved sequence to "+sequenceDir);
+        sequenceDir = "";
+        return;
     }
+    QString number = QString("%1").arg(sequenceFrame, 6, 'd', 0, QChar('0'));
+    QString format = (prefs->getFormat()).toLower();
+    ui->animSlider->setValue(sequenceFrame);
+    sequencePath = sequenceDir+"/muviewSequence"+number+"."+format;
+    ui->statusbar->showMessage("Saving file "+sequencePath);
+    saveImageFile(sequencePath);
 }
 
 void Window::watch(const QString& str)
@@ -612,8 +675,36 @@ void Window::toggleDisplay() {
         viewport->toggleDisplay(0);
     } else if (ui->actionCones->isChecked()) {
         viewport->toggleDisplay(1);
-    } else {
+    } else if (ui->actionVectors->isChecked()) {
         viewport->toggleDisplay(2);
+    } else if (ui->actionImpostors->isChecked()) {
+        viewport->toggleDisplay(3);
+    } else if (ui->actionLines->isChecked()) {
+        viewport->toggleDisplay(4);
+    } else {
+        viewport->toggleDisplay(5);
+    }
+}
+
+void Window::toggleFieldLines() {
+    if (ui->actionFieldLinesGrid->isChecked()) {
+        viewport->setFieldLineSeeds("Grid");
+    } else if (ui->actionFieldLinesPlane->isChecked()) {
+        viewport->setFieldLineSeeds("Slice Plane");
+    } else {
+        viewport->setFieldLineSeeds("Off");
+    }
+}
+
+void Window::toggleIsosurface() {
+    if (ui->actionIsoX->isChecked()) {
+        viewport->setIsoComponent("X");
+    } else if (ui->actionIsoY->isChecked()) {
+        viewport->setIsoComponent("Y");
+    } else if (ui->actionIsoZ->isChecked()) {
+        viewport->setIsoComponent("Z");
+    } else {
+        viewport->setIsoComponent("Off");
     }
 }
 
@@ -6,6 +6,7 @@
 #include <QMap>
 #include <QString>
 #include <QDateTime>
+#include <QImage>
 #include <QDir>
 #include <QSharedPointer>
 #include <QVector>
@@ -25,6 +26,7 @@ class QSignalMapper;
 class QGLFunctions;
 class QActionGroup;
 class QFileSystemWatcher;
+class QLabel;
 
 namespace Ui {
     class Window;
@@ -35,7 +37,7 @@ class Window : public QMainWindow
     Q_OBJECT
 
 public:
-    explicit Window(QStringList arguments);
+    Window(QStringList fileargs, QString watchDir);
     ~Window();
     QSize sizeHint();
 protected:
@@ -48,22 +50,29 @@ private slots:
     void saveImageSequence();
     void saveImageFile(QString name);
     void copyImage();
+    void imageRendered(QImage image);
     void watch(const QString& str);
     void stopWatch();
     void toggleDisplay();
+    void toggleFieldLines();
+    void toggleIsosurface();
     void updateWatchedFiles();
     void openSettings();
     void openAbout();
     void updateDisplayData(int index);
     void updatePrefs();
+    void showUploaded(float percent);
 
 private:
     Ui::Window *ui;
     GLWidget *viewport;
     QActionGroup *displayType;
+    QActionGroup *fieldLineSeeds;
+    QActionGroup *isoComponent;
     Preferences *prefs;
     AboutDialog *about;
     QClipboard *clipboard;
+    QLabel *uploadLabel; // Share of the instance data sent at the last push
 
     // Convenience Functions for Sliders
     void initSlider(QSlider *slider);
@@ -101,6 +110,16 @@ private:
     QString watchedDir;
     bool noFollowUpdate;
 
+    // Size of saved images
+    QSize imageSize();
+
+    // Images are rendered on the viewport's thread and saved as they come
+    QStringList imageTargets; // In order of request, "" for the clipboard
+    QString sequenceDir;      // Empty unless saving a sequence
+    QString sequencePath;     // Of the frame being rendered
+    int sequenceFrame;
+    void saveSequenceFrame();
+
 };
 
 #endif